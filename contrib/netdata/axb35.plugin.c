@@ -0,0 +1,307 @@
+// axb35.plugin.c - netdata external plugin for the ec_su_axb35 driver
+//
+// Emits the axb35.cputemp, fanrpm, fanmode, fanlevel and powermode charts.
+// The board is sampled every -s milliseconds (default: once per update);
+// temperature and fan speeds report the peak since the previous update,
+// everything else the latest sample. Fan curves and the temperature min/max
+// are attached to the charts as labels.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "su_axb35_state.h"
+
+static int         update_every = 1;
+static int         priority     = 1;
+static const char *path;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t ns)
+{
+    struct timespec ts = { .tv_sec  = ns / 1000000000ULL,
+                           .tv_nsec = ns % 1000000000ULL };
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+static void format_curve(const uint8_t *curve, char *buf, size_t size)
+{
+    snprintf(buf, size, "%u,%u,%u,%u,%u", curve[0], curve[1], curve[2],
+             curve[3], curve[4]);
+}
+
+// Numeric values used by the charts, matching the old charts.d script.
+static int fan_mode_value(uint8_t mode)
+{
+    switch (mode) {
+    case EC_SU_AXB35_FAN_AUTO:
+        return 1;
+    case EC_SU_AXB35_FAN_CURVE:
+        return 2;
+    case EC_SU_AXB35_FAN_FIXED:
+        return 3;
+    case EC_SU_AXB35_FAN_THERMAL:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+static int power_mode_value(uint8_t mode)
+{
+    switch (mode) {
+    case EC_SU_AXB35_POWER_QUIET:
+        return 1;
+    case EC_SU_AXB35_POWER_BALANCED:
+        return 2;
+    case EC_SU_AXB35_POWER_PERFORMANCE:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+static void chart(const char *id, int n, const char *title, const char *units,
+                  const char *family, const char *type)
+{
+    printf("CHART axb35.%s 'axb35%d' \"%s\" \"%s\" \"%s\" '' %s %d %d '' "
+           "'axb35.plugin' 'axb35'\n",
+           id, n, title, units, family, type, priority + n - 1, update_every);
+}
+
+// (Re)defines all charts, with the current curves and min/max as labels.
+static void create_charts(const struct ec_su_axb35_state *st)
+{
+    char curve[32];
+    int  i;
+
+    chart("cputemp", 1, "CPU Temp", "Degrees", "CPU Temperature", "line");
+    printf("DIMENSION cputemp '' absolute 1 1\n"
+           "DIMENSION cputempmin '' absolute 1 1\n"
+           "DIMENSION cputempmax '' absolute 1 1\n");
+    printf("CLABEL 'temp_min' '%u' 1\n", st->temp_min);
+    printf("CLABEL 'temp_max' '%u' 1\n", st->temp_max);
+    printf("CLABEL_COMMIT\n");
+
+    chart("fanrpm", 2, "Fan RPMs", "rpm", "Fan RPMs", "stacked");
+    for (i = 1; i <= EC_SU_AXB35_FANS; i++)
+        printf("DIMENSION fan%drpm '' absolute 1 1\n", i);
+
+    chart("fanmode", 3,
+          "Fan Modes (1 = Auto, 2 = Curve, 3 = Manual, 4 = Thermal)", "Mode",
+          "Fan Modes", "line");
+    for (i = 1; i <= EC_SU_AXB35_FANS; i++)
+        printf("DIMENSION fan%dmode '' absolute 1 1\n", i);
+
+    chart("fanlevel", 4, "Fan Power Levels (6 = Auto)", "Level",
+          "Fan Power Levels", "line");
+    for (i = 1; i <= EC_SU_AXB35_FANS; i++)
+        printf("DIMENSION fan%dlevel '' absolute 1 1\n", i);
+    for (i = 0; i < EC_SU_AXB35_FANS; i++) {
+        format_curve(st->fan[i].rampup_curve, curve, sizeof(curve));
+        printf("CLABEL 'fan%d_rampup_curve' '%s' 1\n", i + 1, curve);
+        format_curve(st->fan[i].rampdown_curve, curve, sizeof(curve));
+        printf("CLABEL 'fan%d_rampdown_curve' '%s' 1\n", i + 1, curve);
+    }
+    printf("CLABEL_COMMIT\n");
+
+    chart("powermode", 5,
+          "Power Mode (1 = Quiet, 2 = Balanced, 3 = Performance)", "Mode",
+          "Power Modes", "line");
+    printf("DIMENSION powermode '' absolute 1 1\n");
+}
+
+// True if a label value differs from when the charts were defined.
+static bool labels_changed(const struct ec_su_axb35_state *a,
+                           const struct ec_su_axb35_state *b)
+{
+    int i;
+
+    if (a->temp_min != b->temp_min || a->temp_max != b->temp_max)
+        return true;
+    for (i = 0; i < EC_SU_AXB35_FANS; i++) {
+        if (memcmp(a->fan[i].rampup_curve, b->fan[i].rampup_curve,
+                   EC_SU_AXB35_CURVE_POINTS) ||
+            memcmp(a->fan[i].rampdown_curve, b->fan[i].rampdown_curve,
+                   EC_SU_AXB35_CURVE_POINTS))
+            return true;
+    }
+    return false;
+}
+
+// peak holds the highest temperature and rpms since the last update
+static void update_charts(const struct ec_su_axb35_state *st,
+                          const struct ec_su_axb35_state *peak,
+                          uint64_t                        usec)
+{
+    int i;
+
+    printf("BEGIN axb35.fanrpm %llu\n", (unsigned long long)usec);
+    for (i = 0; i < EC_SU_AXB35_FANS; i++)
+        printf("SET fan%drpm = %u\n", i + 1, peak->fan[i].rpm);
+    printf("END\n");
+
+    printf("BEGIN axb35.fanmode %llu\n", (unsigned long long)usec);
+    for (i = 0; i < EC_SU_AXB35_FANS; i++)
+        printf("SET fan%dmode = %d\n", i + 1, fan_mode_value(st->fan[i].mode));
+    printf("END\n");
+
+    printf("BEGIN axb35.fanlevel %llu\n", (unsigned long long)usec);
+    for (i = 0; i < EC_SU_AXB35_FANS; i++)
+        printf("SET fan%dlevel = %u\n", i + 1,
+               st->fan[i].mode == EC_SU_AXB35_FAN_AUTO ? 6 :
+                                                         st->fan[i].level);
+    printf("END\n");
+
+    printf("BEGIN axb35.cputemp %llu\n", (unsigned long long)usec);
+    printf("SET cputemp = %u\n", peak->temp);
+    printf("SET cputempmin = %u\n", st->temp_min);
+    printf("SET cputempmax = %u\n", st->temp_max);
+    printf("END\n");
+
+    printf("BEGIN axb35.powermode %llu\n", (unsigned long long)usec);
+    printf("SET powermode = %d\n", power_mode_value(st->power_mode));
+    printf("END\n\n");
+}
+
+static void fold_peak(struct ec_su_axb35_state       *peak,
+                      const struct ec_su_axb35_state *st)
+{
+    int i;
+
+    if (st->temp > peak->temp)
+        peak->temp = st->temp;
+    for (i = 0; i < EC_SU_AXB35_FANS; i++) {
+        if (st->fan[i].rpm > peak->fan[i].rpm)
+            peak->fan[i].rpm = st->fan[i].rpm;
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [OPTIONS] [UPDATE_EVERY]\n\n"
+            "OPTIONS:\n"
+            "  -s MS      Sample interval in ms, down to 10 (default: "
+            "UPDATE_EVERY)\n"
+            "  -P N       Chart priority (default: 1)\n"
+            "  -p PATH    Read sysfs under PATH instead of the state device "
+            "or %s\n"
+            "  -h         Display this usage information\n",
+            prog, SU_AXB35_CLASS_PATH);
+}
+
+int main(int argc, char **argv)
+{
+    struct su_axb35          ec;
+    struct ec_su_axb35_state cur;
+    struct ec_su_axb35_state st; // latest good sample
+    struct ec_su_axb35_state peak;
+    struct ec_su_axb35_state labels;
+    uint64_t                 sample_ns = 0;
+    uint64_t                 next_sample;
+    uint64_t                 next_update;
+    uint64_t                 last_update = 0;
+    bool                     have_peak   = false;
+    int                      opt;
+
+    while ((opt = getopt(argc, argv, "s:P:p:h")) != -1) {
+        switch (opt) {
+        case 's':
+            sample_ns = strtoull(optarg, NULL, 10) * 1000000ULL;
+            break;
+        case 'P':
+            priority = atoi(optarg);
+            break;
+        case 'p':
+            path = optarg;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    // netdata passes the update frequency as the only argument
+    if (optind < argc)
+        update_every = atoi(argv[optind]);
+    if (update_every < 1)
+        update_every = 1;
+    if (!sample_ns || sample_ns > update_every * 1000000000ULL)
+        sample_ns = update_every * 1000000000ULL;
+    if (sample_ns < 10000000ULL)
+        sample_ns = 10000000ULL;
+
+    setvbuf(stdout, NULL, _IOFBF, 0);
+
+    if (su_axb35_open(&ec, path) || su_axb35_read(&ec, &st)) {
+        fprintf(stderr, "axb35.plugin: can't read the AXB35 EC: %s\n",
+                strerror(errno));
+        // tells netdata not to restart the plugin
+        printf("DISABLE\n");
+        return 1;
+    }
+
+    labels = st;
+    peak   = st;
+    create_charts(&labels);
+    fflush(stdout);
+
+    next_sample = now_ns();
+    next_update = next_sample + update_every * 1000000000ULL;
+
+    for (;;) {
+        uint64_t now;
+
+        next_sample += sample_ns;
+        sleep_until(next_sample);
+
+        if (su_axb35_read(&ec, &cur) == 0) {
+            st = cur;
+            if (!have_peak)
+                peak = st;
+            else
+                fold_peak(&peak, &st);
+            have_peak = true;
+        }
+
+        now = now_ns();
+        if (now < next_update)
+            continue;
+        next_update += update_every * 1000000000ULL;
+        if (next_update <= now)
+            next_update = now + update_every * 1000000000ULL;
+
+        if (!have_peak)
+            continue;
+
+        if (labels_changed(&labels, &st)) {
+            labels = st;
+            create_charts(&labels);
+        }
+        update_charts(&st, &peak,
+                      last_update ? (now - last_update) / 1000 : 0);
+        last_update = now;
+        have_peak   = false;
+
+        if (fflush(stdout) == EOF || ferror(stdout))
+            return 1;
+    }
+}
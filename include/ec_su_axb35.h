@@ -0,0 +1,96 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+// ec_su_axb35.h - userspace interface of the ec_su_axb35 driver
+
+#ifndef _EC_SU_AXB35_H
+#define _EC_SU_AXB35_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+#define EC_SU_AXB35_DEV         "/dev/ec_su_axb35"
+#define EC_SU_AXB35_HISTORY_DEV "/dev/ec_su_axb35_history"
+
+#define EC_SU_AXB35_FANS          3
+#define EC_SU_AXB35_CURVE_POINTS  5
+#define EC_SU_AXB35_STATE_VERSION 1
+
+// fan mode. New modes may be added without a new
+// EC_SU_AXB35_STATE_VERSION, as they do not change the layout; readers show
+// values they do not know as unknown. 3 (thermal) was added after version 1.
+#define EC_SU_AXB35_FAN_AUTO    0
+#define EC_SU_AXB35_FAN_FIXED   1
+#define EC_SU_AXB35_FAN_CURVE   2
+#define EC_SU_AXB35_FAN_THERMAL 3 // level set by the kernel thermal governor
+
+// APU power mode, raw EC value
+#define EC_SU_AXB35_POWER_BALANCED    0x00
+#define EC_SU_AXB35_POWER_PERFORMANCE 0x01
+#define EC_SU_AXB35_POWER_QUIET       0x02
+
+struct ec_su_axb35_fan_state {
+    __u16 rpm;
+    __u8  mode;  // EC_SU_AXB35_FAN_*
+    __u8  level; // 0-5
+    __u8  rampup_curve[EC_SU_AXB35_CURVE_POINTS];   // °C for level 1-5
+    __u8  rampdown_curve[EC_SU_AXB35_CURVE_POINTS]; // °C for level 1-5
+} __attribute__((packed));
+
+// Returned by read() on /dev/ec_su_axb35. All fields come from the same EC
+// register snapshot. Readers should check version and size before use; new
+// fields are only ever appended.
+struct ec_su_axb35_state {
+    __u16 version; // EC_SU_AXB35_STATE_VERSION
+    __u16 size;    // sizeof(struct ec_su_axb35_state)
+    __u32 reserved;
+    __u64 seq;          // snapshot sequence number
+    __u64 timestamp_ns; // CLOCK_MONOTONIC time of the snapshot
+    struct ec_su_axb35_fan_state fan[EC_SU_AXB35_FANS];
+    __u8  temp;       // °C
+    __u8  temp_min;   // °C since driver load
+    __u8  temp_max;   // °C since driver load
+    __u8  power_mode; // EC_SU_AXB35_POWER_*
+} __attribute__((packed));
+
+// Page mapped read-only by mmap() on /dev/ec_su_axb35 (offset 0). The
+// driver republishes state on every snapshot refresh. seq is odd while an
+// update is in progress; copy state only when seq reads the same even value
+// before and after the copy, otherwise retry.
+struct ec_su_axb35_live {
+    __u32                    seq;
+    __u32                    reserved;
+    struct ec_su_axb35_state state;
+};
+
+// curve controller action in a history sample
+#define EC_SU_AXB35_ACTION_NONE 0
+#define EC_SU_AXB35_ACTION_UP   1
+#define EC_SU_AXB35_ACTION_DOWN 2
+
+// One record per worker tick, read() from /dev/ec_su_axb35_history returns
+// as many whole records as fit in the buffer. Each open file has its own
+// cursor; a gap in seq means the reader fell behind and was overrun.
+struct ec_su_axb35_sample {
+    __u64 seq;
+    __u64 timestamp_ns; // CLOCK_MONOTONIC
+    __u16 rpm[EC_SU_AXB35_FANS];
+    __u8  mode[EC_SU_AXB35_FANS];
+    __u8  level[EC_SU_AXB35_FANS];
+    __u8  action[EC_SU_AXB35_FANS]; // EC_SU_AXB35_ACTION_*
+    __u8  temp;
+    __u8  power_mode;
+    __u8  reserved[7];
+} __attribute__((packed));
+
+struct ec_su_axb35_history_info {
+    __u64 head;     // seq of the next sample to be written
+    __u64 cursor;   // seq of the next sample this file will read
+    __u64 overruns; // samples this file lost to overwrites
+    __u32 capacity; // samples kept by the driver
+    __u32 record_size;
+};
+
+#define EC_SU_AXB35_IOC_MAGIC 0xE5
+#define EC_SU_AXB35_IOC_HISTORY_INFO \
+    _IOR(EC_SU_AXB35_IOC_MAGIC, 1, struct ec_su_axb35_history_info)
+
+#endif // _EC_SU_AXB35_H
@@ -1,74 +1,236 @@
 // ec_su_axb35.c
 
 #include <linux/acpi.h>
+#include <linux/bitmap.h>
+#include <linux/cdev.h>
+#include <linux/ctype.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/device.h>
 #include <linux/fs.h>
+#include <linux/hwmon-sysfs.h>
+#include <linux/hwmon.h>
 #include <linux/init.h>
 #include <linux/io.h>
+#include <linux/jiffies.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
+#include <linux/platform_device.h>
+#include <linux/platform_profile.h>
+#include <linux/poll.h>
+#include <linux/rcupdate.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/thermal.h>
 #include <linux/uaccess.h>
 #include <linux/version.h>
 #include <linux/workqueue.h>
 
+#include "ec_su_axb35.h"
+#include "ec_su_axb35_backend.h"
+
+#define CREATE_TRACE_POINTS
+#include "ec_su_axb35_trace.h"
+
 extern int ec_read(u8 addr, u8 *val);
 extern int ec_write(u8 addr, u8 val);
 
-enum fan_mode { AUTO, FIXED, CURVE };
+static const struct ec_backend ec_acpi_backend = {
+    .name  = "acpi",
+    .read  = ec_read,
+    .write = ec_write,
+};
+
+static const struct ec_backend *ec_backend = &ec_acpi_backend;
+
+static char *backend = "acpi";
+module_param(backend, charp, 0444);
+MODULE_PARM_DESC(backend,
+                 "EC backend: acpi (default) or sim for a simulated board");
+
+// THERMAL leaves the level to the kernel thermal governor
+enum fan_mode { AUTO, FIXED, CURVE, THERMAL };
+
+// STEP moves one level per tick, DIRECT jumps towards the target level
+enum fan_controller { STEP, DIRECT };
+
+// Controller settings of a fan. The worker reads them under RCU only;
+// writers serialize on ec_config_lock and publish a new copy, so a tick
+// never acts on a half-written curve. The mode is not part of it, since it
+// follows the EC register and is kept under ec_lock; a writer that changes
+// both publishes the config while holding ec_lock once the mode reached the
+// EC (see ec_profile_apply()), so a tick sees both changes or neither.
+struct ec_fan_config {
+    u8                  rampup_curve[6];
+    u8                  rampdown_curve[6];
+    enum fan_controller controller;
+    u8                  max_step_up;   // levels per tick, DIRECT only
+    u8                  max_step_down; // levels per tick, DIRECT only
+    struct rcu_head     rcu;
+};
+
+// Windowed statistics of one value (temperature or fan speed). Each window
+// is split into EC_WINDOW_SLOTS slots; a sample goes into the current slot
+// of every window, and a window is the sum of its slots that are not older
+// than the window length, so adding a sample is O(1) and old data ages out
+// one slot at a time.
+#define EC_WINDOWS      4
+#define EC_WINDOW_SLOTS 10
+#define EC_WINDOW_BINS  64 // histogram for the p95
+
+struct ec_window_slot {
+    u64 epoch; // time / slot length, 0 = empty
+    u32 min;
+    u32 max;
+    u64 sum; // value * ms
+    u32 ms;
+    u32 above_ms;
+    u32 hist[EC_WINDOW_BINS]; // ms per bin
+};
+
+struct ec_window {
+    struct ec_window_slot slot[EC_WINDOW_SLOTS];
+    s64                   ewma; // value * 1000, time constant = window length
+};
+
+struct ec_series {
+    unsigned int     bin_width;
+    unsigned int     threshold; // for above_threshold_ms
+    u64              last_ms;   // time of the last sample, 0 = none
+    struct ec_window win[EC_WINDOWS];
+};
+
+// fan quirks
+#define EC_FAN_QUIRK_8000_IS_OFF BIT(0) // reads 8000 rpm before stopping
+
+#define EC_RPM_FILTER_MAX 9 // longest median window
 
 struct ec_fan {
-    const char    *name;
-    u8             speed_reg_high;
-    u8             speed_reg_low;
-    u8             mode_reg;
-    u8             rampup_curve[6];
-    u8             rampdown_curve[6];
-    enum fan_mode  mode;
-    struct device *dev;
+    const char                 *name;
+    const char                 *label;
+    u8                          speed_reg_high;
+    u8                          speed_reg_low;
+    u8                          mode_reg;
+    u32                         quirks;
+    struct ec_fan_config        defaults;
+    struct ec_fan_config __rcu *config;
+    enum fan_mode               mode;
+    u16                         rpm;     // snapshot, filtered
+    u16                         rpm_raw; // snapshot
+    u8                          level;   // snapshot
+    u8                          rpm_filter; // median window, 0 = off
+    u8                          rpm_hist_len;
+    u8                          rpm_hist_pos;
+    u16                         rpm_hist[EC_RPM_FILTER_MAX];
+    u8                          tracked_level;
+    unsigned long               level_since;  // jiffies
+    unsigned long               stall_since;  // jiffies, 0 = turning
+    u16                         level_rpm[6]; // learned speed per level
+    bool                        fault;
+    u8                          cooling_state; // last governor request
+    u16                         notified_rpm;
+    u8                          notified_level;
+    enum fan_mode               notified_mode;
+    struct ec_series            series;
+    struct device              *dev;
 };
 
 struct ec_temp {
-    const char    *name;
-    u8             reg;
-    u8             temp_min;
-    u8             temp_max;
-    struct device *dev;
+    const char      *name;
+    u8               reg;
+    u8               temp;  // snapshot
+    u8               temp_min;
+    u8               temp_max;
+    u8               notified_temp;
+    u8               notified_min;
+    u8               notified_max;
+    struct ec_series series;
+    struct device   *dev;
 };
 
 struct ec_apu {
     const char    *name;
     u8             power_mode_reg;
+    u8             power_mode; // snapshot
+    u8             notified_power_mode;
     struct device *dev;
 };
 
+// All sysfs readers are served from one snapshot of the EC registers. The
+// snapshot is refreshed by ec_update_worker() every tick and on demand when
+// it is older than snapshot_max_age_ms, so concurrent readers no longer
+// multiply the number of EC transactions.
+static unsigned int snapshot_max_age_ms = 500;
+module_param(snapshot_max_age_ms, uint, 0644);
+MODULE_PARM_DESC(snapshot_max_age_ms,
+                 "Maximum age of the cached EC register snapshot in ms "
+                 "before a read refreshes it (default: 500, 0 = always)");
+
+// sysfs_notify() thresholds, so poll() on an attribute only wakes up on
+// changes that matter
+static unsigned int notify_temp_delta = 1;
+module_param(notify_temp_delta, uint, 0644);
+MODULE_PARM_DESC(notify_temp_delta,
+                 "Minimum temperature change in °C that wakes poll() on "
+                 "temp1/temp (default: 1)");
+
+static unsigned int notify_rpm_delta = 100;
+module_param(notify_rpm_delta, uint, 0644);
+MODULE_PARM_DESC(notify_rpm_delta,
+                 "Minimum fan speed change in rpm that wakes poll() on "
+                 "fanX/rpm (default: 100)");
+
+// serializes EC access and the snapshot
+static DEFINE_MUTEX(ec_lock);
+static unsigned long ec_snapshot_stamp;
+static u64           ec_snapshot_time; // ns, for userspace
+static u64           ec_snapshot_seq;
+static bool          ec_snapshot_valid;
+
+static dev_t         ec_su_axb35_dev;
 static struct class *ec_class;
 
 static struct ec_fan ec_fans[] = {
     { .name           = "fan1",
+      .label          = "CPU fan 1",
       .speed_reg_high = 0x35,
       .speed_reg_low  = 0x36,
       .mode_reg       = 0x21,
-      .rampup_curve   = { 0, 60, 70, 83, 95, 97 },
-      .rampdown_curve = { 0, 40, 50, 80, 94, 96 } },
+      .defaults       = { .rampup_curve   = { 0, 60, 70, 83, 95, 97 },
+                          .rampdown_curve = { 0, 40, 50, 80, 94, 96 },
+                          .max_step_up    = 5,
+                          .max_step_down  = 1 },
+      .series         = { .bin_width = 100, .threshold = 3000 } },
     { .name           = "fan2",
+      .label          = "CPU fan 2",
       .speed_reg_high = 0x37,
       .speed_reg_low  = 0x38,
       .mode_reg       = 0x23,
-      .rampup_curve   = { 0, 60, 70, 83, 95, 97 },
-      .rampdown_curve = { 0, 40, 50, 80, 94, 96 } },
+      .defaults       = { .rampup_curve   = { 0, 60, 70, 83, 95, 97 },
+                          .rampdown_curve = { 0, 40, 50, 80, 94, 96 },
+                          .max_step_up    = 5,
+                          .max_step_down  = 1 },
+      .series         = { .bin_width = 100, .threshold = 3000 } },
     { .name           = "fan3",
+      .label          = "System fan",
       .speed_reg_high = 0x28,
       .speed_reg_low  = 0x29,
       .mode_reg       = 0x25,
-      .rampup_curve   = { 0, 20, 60, 83, 95, 97 },
-      .rampdown_curve = { 0, 0, 50, 80, 94, 96 } },
+      .quirks         = EC_FAN_QUIRK_8000_IS_OFF,
+      .defaults       = { .rampup_curve   = { 0, 20, 60, 83, 95, 97 },
+                          .rampdown_curve = { 0, 0, 50, 80, 94, 96 },
+                          .max_step_up    = 5,
+                          .max_step_down  = 1 },
+      .series         = { .bin_width = 100, .threshold = 3000 } },
 };
 
 static struct ec_temp ec_temp = {
-    .name = "temp1",
-    .reg  = 0x70,
+    .name   = "temp1",
+    .reg    = 0x70,
+    .series = { .bin_width = 2, .threshold = 80 },
 };
 
 static struct ec_apu ec_apu = {
@@ -76,32 +238,416 @@ static struct ec_apu ec_apu = {
     .power_mode_reg = 0x31,
 };
 
-static ssize_t fan_rpm_show(struct device *dev, struct device_attribute *attr,
-                            char *buf)
+// index into ec_profiles of the profile applied last, -1 once any of its
+// settings is changed on its own
+static int ec_profile_active = -1;
+
+static void ec_profile_clear(void)
 {
-    struct ec_fan *fan = dev_get_drvdata(dev);
-    u8             hi;
-    // TODO: handle error
-    ec_read(fan->speed_reg_high, &hi);
-    u8 lo;
-    // TODO: handle error
-    ec_read(fan->speed_reg_low, &lo);
-    u16 rpm = (hi << 8) | lo;
-    // wired fan3 behavior, displaying 8000 before turning to 0
-    if (strcmp(fan->name, "fan3") == 0 && rpm == 8000)
-        rpm = 0;
-    return sprintf(buf, "%u\n", rpm);
+    WRITE_ONCE(ec_profile_active, -1);
 }
 
-static struct device_attribute dev_attr_fan_rpm =
-    __ATTR(rpm, 0444, fan_rpm_show, NULL);
+// EC access accounting: per-register call and failure counts, per-operation
+// latency histograms and the time each worker tick and each restore on
+// resume takes, exposed in debugfs. All counters are updated under ec_lock.
+
+#define EC_STATS_BUCKETS 32 // log2(ns)
+
+enum ec_op { EC_OP_READ, EC_OP_WRITE, EC_OP_TICK, EC_OP_RESUME, EC_OP_COUNT };
+
+static const char *const ec_op_names[EC_OP_COUNT] = { "read", "write", "tick",
+                                                      "resume" };
+
+struct ec_op_stats {
+    u64 count;
+    u64 failed;
+    u64 total_ns;
+    u64 min_ns;
+    u64 max_ns;
+    u64 hist[EC_STATS_BUCKETS];
+};
+
+struct ec_reg_stats {
+    u64 count[2]; // EC_OP_READ, EC_OP_WRITE
+    u64 failed[2];
+    u64 skipped; // no-op writes absorbed by the shadow
+};
+
+static struct ec_op_stats  ec_op_stats[EC_OP_COUNT];
+static struct ec_reg_stats ec_reg_stats[256];
 
-static void update_fan_mode(struct ec_fan *fan)
+// Returns the duration in ns.
+static u64 ec_stats_record(enum ec_op op, u64 start_ns, int ret)
 {
-    u8 val;
-    // TODO: handle error
-    ec_read(fan->mode_reg, &val);
+    struct ec_op_stats *st = &ec_op_stats[op];
+    u64                 ns = ktime_get_ns() - start_ns;
+
+    if (st->count == 0 || ns < st->min_ns)
+        st->min_ns = ns;
+    if (ns > st->max_ns)
+        st->max_ns = ns;
+    st->count++;
+    st->total_ns += ns;
+    st->hist[min(fls64(ns), EC_STATS_BUCKETS - 1)]++;
+    if (ret)
+        st->failed++;
+    return ns;
+}
+
+// Caller holds ec_lock.
+static int ec_su_read(u8 reg, u8 *val)
+{
+    u64 start = ktime_get_ns();
+    int ret   = ec_backend->read(reg, val);
+    u64 ns    = ec_stats_record(EC_OP_READ, start, ret);
+
+    trace_ec_su_axb35_ec_read(reg, ret ? 0 : *val, ret, ns);
+    ec_reg_stats[reg].count[EC_OP_READ]++;
+    if (ret)
+        ec_reg_stats[reg].failed[EC_OP_READ]++;
+    return ret;
+}
+
+// Caller holds ec_lock.
+static int ec_su_write(u8 reg, u8 val)
+{
+    u64 start = ktime_get_ns();
+    int ret   = ec_backend->write(reg, val);
+    u64 ns    = ec_stats_record(EC_OP_WRITE, start, ret);
+
+    trace_ec_su_axb35_ec_write(reg, val, ret, ns);
+    ec_reg_stats[reg].count[EC_OP_WRITE]++;
+    if (ret)
+        ec_reg_stats[reg].failed[EC_OP_WRITE]++;
+    return ret;
+}
+
+// upper bound in ns of the bucket holding the given percentile
+static u64 ec_stats_percentile(const struct ec_op_stats *st, unsigned int pct)
+{
+    u64 want = div_u64(st->count * pct + 99, 100);
+    u64 seen = 0;
+    int i;
+
+    for (i = 0; i < EC_STATS_BUCKETS; i++) {
+        seen += st->hist[i];
+        if (seen >= want)
+            return i ? 1ULL << i : 0;
+    }
+    return st->max_ns;
+}
+
+static int ec_stats_show(struct seq_file *m, void *v)
+{
+    struct ec_op_stats  *ops;
+    struct ec_reg_stats *regs;
+    int                  i;
+    int                  j;
+
+    // copy out so the EC is not held while printing
+    ops  = kmalloc(sizeof(ec_op_stats), GFP_KERNEL);
+    regs = kmalloc(sizeof(ec_reg_stats), GFP_KERNEL);
+    if (!ops || !regs) {
+        kfree(ops);
+        kfree(regs);
+        return -ENOMEM;
+    }
+
+    mutex_lock(&ec_lock);
+    memcpy(ops, ec_op_stats, sizeof(ec_op_stats));
+    memcpy(regs, ec_reg_stats, sizeof(ec_reg_stats));
+    mutex_unlock(&ec_lock);
+
+    seq_puts(m, "op     count        failed   min_us   avg_us   max_us   "
+                "p99_us\n");
+    for (i = 0; i < EC_OP_COUNT; i++) {
+        struct ec_op_stats *st  = &ops[i];
+        u64                 avg = 0;
+
+        if (st->count)
+            avg = div64_u64(st->total_ns, st->count);
+
+        seq_printf(m, "%-6s %-12llu %-8llu %-8llu %-8llu %-8llu %llu\n",
+                   ec_op_names[i], st->count, st->failed,
+                   div_u64(st->min_ns, NSEC_PER_USEC),
+                   div_u64(avg, NSEC_PER_USEC),
+                   div_u64(st->max_ns, NSEC_PER_USEC),
+                   div_u64(ec_stats_percentile(st, 99), NSEC_PER_USEC));
+    }
+
+    for (i = 0; i < EC_OP_COUNT; i++) {
+        seq_printf(m, "\n%s latency histogram (upper bound, count)\n",
+                   ec_op_names[i]);
+        for (j = 0; j < EC_STATS_BUCKETS; j++) {
+            if (ops[i].hist[j])
+                seq_printf(m, "  <%lluns %llu\n", 1ULL << j, ops[i].hist[j]);
+        }
+    }
+
+    seq_puts(m, "\nreg   reads        read_failed  writes       "
+                "write_failed skipped\n");
+    for (i = 0; i < ARRAY_SIZE(ec_reg_stats); i++) {
+        struct ec_reg_stats *rs = &regs[i];
+
+        if (!rs->count[EC_OP_READ] && !rs->count[EC_OP_WRITE] &&
+            !rs->skipped)
+            continue;
+        seq_printf(m, "0x%02x  %-12llu %-12llu %-12llu %-12llu %llu\n", i,
+                   rs->count[EC_OP_READ], rs->failed[EC_OP_READ],
+                   rs->count[EC_OP_WRITE], rs->failed[EC_OP_WRITE],
+                   rs->skipped);
+    }
+
+    kfree(ops);
+    kfree(regs);
+    return 0;
+}
+
+DEFINE_SHOW_ATTRIBUTE(ec_stats);
+
+static ssize_t ec_stats_reset_write(struct file *file, const char __user *buf,
+                                    size_t count, loff_t *ppos)
+{
+    mutex_lock(&ec_lock);
+    memset(ec_op_stats, 0, sizeof(ec_op_stats));
+    memset(ec_reg_stats, 0, sizeof(ec_reg_stats));
+    mutex_unlock(&ec_lock);
+
+    return count;
+}
+
+static const struct file_operations ec_stats_reset_fops = {
+    .owner = THIS_MODULE,
+    .write = ec_stats_reset_write,
+};
+
+static struct dentry *ec_debugfs;
+
+// Shadow of the writable registers (fan modes and levels, power mode).
+// Writers stage values with ec_shadow_set(), and ec_shadow_flush() writes
+// the ones that differ from what the EC holds in one batch, in ascending
+// register order (a fan's mode before its level). Reads of shadowed
+// registers are served from the shadow and only go to the EC every
+// shadow_resync_ms, so changes the firmware makes on its own are picked up.
+// All of it is protected by ec_lock.
+
+static unsigned int shadow_resync_ms = 5000;
+module_param(shadow_resync_ms, uint, 0644);
+MODULE_PARM_DESC(shadow_resync_ms,
+                 "Interval in ms at which shadowed registers are re-read "
+                 "from the EC (default: 5000, 0 = on every refresh)");
+
+static u8            ec_shadow[256];  // value the EC holds
+static u8            ec_pending[256]; // value to write on the next flush
+static DECLARE_BITMAP(ec_shadow_valid, 256);
+static DECLARE_BITMAP(ec_shadow_dirty, 256);
+static unsigned long ec_shadow_synced; // jiffies
+
+static int ec_shadow_read(u8 reg, u8 *val, bool resync)
+{
+    int ret;
+
+    if (resync || !test_bit(reg, ec_shadow_valid)) {
+        ret = ec_su_read(reg, &ec_shadow[reg]);
+        if (ret) {
+            clear_bit(reg, ec_shadow_valid);
+            return ret;
+        }
+        set_bit(reg, ec_shadow_valid);
+    }
+
+    *val = ec_shadow[reg];
+    return 0;
+}
+
+static void ec_shadow_set(u8 reg, u8 val)
+{
+    ec_pending[reg] = val;
+    set_bit(reg, ec_shadow_dirty);
+}
+
+// Writes all dirty registers, returning the first error. A register whose
+// write failed is re-read from the EC on the next refresh.
+static int ec_shadow_flush(void)
+{
+    unsigned int reg;
+    int          err = 0;
+    int          ret;
+
+    for_each_set_bit(reg, ec_shadow_dirty, 256) {
+        clear_bit(reg, ec_shadow_dirty);
+
+        if (test_bit(reg, ec_shadow_valid) &&
+            ec_shadow[reg] == ec_pending[reg]) {
+            ec_reg_stats[reg].skipped++;
+            continue;
+        }
+
+        ret = ec_su_write(reg, ec_pending[reg]);
+        if (ret) {
+            clear_bit(reg, ec_shadow_valid);
+            if (!err)
+                err = ret;
+            continue;
+        }
+        ec_shadow[reg] = ec_pending[reg];
+        set_bit(reg, ec_shadow_valid);
+    }
+
+    return err;
+}
+
+// Whether the EC is known to hold val in reg, e.g. after a failed flush.
+static bool ec_shadow_holds(u8 reg, u8 val)
+{
+    return test_bit(reg, ec_shadow_valid) && ec_shadow[reg] == val;
+}
+
+// Windowed statistics, fed from every snapshot refresh. Protected by
+// ec_lock.
+
+static void ec_worker_kick(void);
+static int  ec_worker_param_set(const char *val, const struct kernel_param *kp);
+
+static const struct kernel_param_ops ec_worker_param_ops = {
+    .set = ec_worker_param_set,
+    .get = param_get_bool,
+};
+
+// off by default, as it keeps the worker from ever stopping with idle_stop
+static bool window_stats;
+module_param_cb(window_stats, &ec_worker_param_ops, &window_stats, 0644);
+MODULE_PARM_DESC(window_stats,
+                 "Keep windowed temperature and fan speed statistics; keeps "
+                 "the worker running (default: N)");
+
+static unsigned int stats_windows[EC_WINDOWS] = { 10, 60, 300 };
+static unsigned int stats_windows_count       = 3;
+module_param_array(stats_windows, uint, &stats_windows_count, 0444);
+MODULE_PARM_DESC(stats_windows,
+                 "Lengths in s of up to 4 statistics windows, load time only "
+                 "(default: 10,60,300)");
+
+static u64 ec_window_slot_ms(int w)
+{
+    return div_u64((u64)stats_windows[w] * MSEC_PER_SEC, EC_WINDOW_SLOTS);
+}
+
+// Adds a sample that has held since the previous one, at most for one slot.
+static void ec_series_add(struct ec_series *ser, u32 val, u64 now_ms)
+{
+    unsigned int bin   = min(val / ser->bin_width, EC_WINDOW_BINS - 1U);
+    bool         first = !ser->last_ms;
+    u64          dt    = first ? 0 : now_ms - ser->last_ms;
+    int          w;
+
+    ser->last_ms = now_ms;
+
+    for (w = 0; w < stats_windows_count; w++) {
+        struct ec_window      *win     = &ser->win[w];
+        u64                    slot_ms = ec_window_slot_ms(w);
+        u64                    epoch   = div64_u64(now_ms, slot_ms);
+        u64                    tau     = slot_ms * EC_WINDOW_SLOTS;
+        u32                    ms      = min(dt, slot_ms);
+        struct ec_window_slot *sl;
+        u32                    idx;
+
+        div_u64_rem(epoch, EC_WINDOW_SLOTS, &idx);
+        sl = &win->slot[idx];
+        if (sl->epoch != epoch) {
+            memset(sl, 0, sizeof(*sl));
+            sl->epoch = epoch;
+            sl->min   = val;
+            sl->max   = val;
+        }
+
+        sl->min = min(sl->min, val);
+        sl->max = max(sl->max, val);
+        sl->sum += (u64)val * ms;
+        sl->ms += ms;
+        sl->hist[bin] += ms;
+        if (val > ser->threshold)
+            sl->above_ms += ms;
+
+        // first order, alpha = dt / (tau + dt)
+        if (first)
+            win->ewma = (s64)val * 1000;
+        else
+            win->ewma += div64_s64(((s64)val * 1000 - win->ewma) * (s64)ms,
+                                   tau + ms);
+    }
+}
+
+static void ec_series_reset(struct ec_series *ser)
+{
+    memset(ser->win, 0, sizeof(ser->win));
+    ser->last_ms = 0;
+}
+
+struct ec_window_sum {
+    u64 min;
+    u64 max;
+    u64 mean;
+    u64 ewma;
+    u64 p95;
+    u64 above_ms;
+};
+
+static void ec_window_sum(struct ec_series *ser, int w, u64 now_ms,
+                          struct ec_window_sum *sum)
+{
+    struct ec_window *win     = &ser->win[w];
+    u64               slot_ms = ec_window_slot_ms(w);
+    u64               epoch   = div64_u64(now_ms, slot_ms);
+    u32               hist[EC_WINDOW_BINS] = { 0 };
+    u64               total                = 0;
+    u64               weighted             = 0;
+    u64               acc                  = 0;
+    bool              any                  = false;
+    int               i;
+    int               j;
+
+    memset(sum, 0, sizeof(*sum));
+
+    for (i = 0; i < EC_WINDOW_SLOTS; i++) {
+        struct ec_window_slot *sl = &win->slot[i];
+
+        if (!sl->epoch || sl->epoch + EC_WINDOW_SLOTS <= epoch)
+            continue;
+
+        sum->min = any ? min_t(u64, sum->min, sl->min) : sl->min;
+        sum->max = any ? max_t(u64, sum->max, sl->max) : sl->max;
+        any      = true;
+        weighted += sl->sum;
+        total += sl->ms;
+        sum->above_ms += sl->above_ms;
+        for (j = 0; j < EC_WINDOW_BINS; j++)
+            hist[j] += sl->hist[j];
+    }
+
+    if (!any)
+        return;
+
+    sum->ewma = div_u64(max_t(s64, win->ewma, 0) + 500, 1000);
+    if (!total) {
+        sum->mean = sum->min;
+        sum->p95  = sum->max;
+        return;
+    }
+    sum->mean = div64_u64(weighted + total / 2, total);
+
+    // middle of the bin that holds the 95th percentile
+    for (j = 0; j < EC_WINDOW_BINS; j++) {
+        acc += hist[j];
+        if (acc * 100 >= total * 95)
+            break;
+    }
+    sum->p95 = clamp_t(u64, j * ser->bin_width + ser->bin_width / 2,
+                       sum->min, sum->max);
+}
 
+static void update_fan_mode(struct ec_fan *fan, u8 val)
+{
     switch (val) {
     case 0x10:
     case 0x20:
@@ -111,47 +657,17 @@ static void update_fan_mode(struct ec_fan *fan)
     case 0x11:
     case 0x21:
     case 0x31:
-        // curve and fixed use the value in the EC register
-        // so fixed is only allowed if it was already know as
-        // FIXED to the driver
-        if (fan->mode != FIXED) {
+        // curve, fixed and thermal use the value in the EC register
+        // so fixed and thermal are only allowed if they were already
+        // known to the driver
+        if (fan->mode != FIXED && fan->mode != THERMAL)
             fan->mode = CURVE;
-        } else {
-            fan->mode = FIXED;
-        }
-        break;
-    }
-}
-
-static ssize_t fan_mode_show(struct device *dev, struct device_attribute *attr,
-                             char *buf)
-{
-    struct ec_fan *fan = dev_get_drvdata(dev);
-
-    update_fan_mode(fan);
-
-    const char *mode = "unknown";
-    switch (fan->mode) {
-    case AUTO:
-        mode = "auto";
-        break;
-    case FIXED:
-        mode = "fixed";
-        break;
-    case CURVE:
-        mode = "curve";
         break;
     }
-
-    return sprintf(buf, "%s\n", mode);
 }
 
-static u8 read_fan_level(struct ec_fan *fan)
+static u8 decode_fan_level(u8 val)
 {
-    u8 val;
-    // TODO: handle error
-    ec_read(fan->mode_reg + 1, &val);
-
     switch (val & 0xF) {
     case 0x2: // 20%
         return 1;
@@ -169,373 +685,2928 @@ static u8 read_fan_level(struct ec_fan *fan)
     }
 }
 
-static ssize_t fan_level_show(struct device *dev, struct device_attribute *attr,
-                              char *buf)
+// The speed is two registers the firmware updates independently, so the
+// high byte is read again after the low byte; if it changed, the pair may
+// be torn and is read again, up to EC_RPM_READ_TRIES times.
+#define EC_RPM_READ_TRIES 3
+
+static int read_fan_rpm(struct ec_fan *fan, u16 *rpm)
 {
-    struct ec_fan *fan = dev_get_drvdata(dev);
-    return sprintf(buf, "%u\n", read_fan_level(fan));
+    u8  hi;
+    u8  hi2;
+    u8  lo;
+    int tries = 0;
+    int ret;
+
+    ret = ec_su_read(fan->speed_reg_high, &hi);
+    if (ret)
+        return ret;
+    do {
+        ret = ec_su_read(fan->speed_reg_low, &lo);
+        if (ret)
+            return ret;
+        ret = ec_su_read(fan->speed_reg_high, &hi2);
+        if (ret)
+            return ret;
+        if (hi2 == hi)
+            break;
+        hi = hi2;
+    } while (++tries < EC_RPM_READ_TRIES);
+
+    *rpm = (hi << 8) | lo;
+    if ((fan->quirks & EC_FAN_QUIRK_8000_IS_OFF) && *rpm == 8000)
+        *rpm = 0;
+    return 0;
 }
 
-static void write_fan_level(struct ec_fan *fan, u8 level)
+static unsigned int rpm_filter;
+module_param(rpm_filter, uint, 0444);
+MODULE_PARM_DESC(rpm_filter,
+                 "Initial median filter window of every fan's rpm in samples "
+                 "(default: 0 = off, max: 9, per fan: fanX/rpm_filter)");
+
+// Median of the last rpm_filter raw speeds, so single glitches never show
+// up in rpm. Caller holds ec_lock.
+static u16 fan_rpm_filter(struct ec_fan *fan, u16 raw)
 {
-    u8 val;
+    u16 sorted[EC_RPM_FILTER_MAX];
+    int n = fan->rpm_filter;
+    int i;
+    int j;
 
-    switch (fan->mode_reg) {
-    case 0x21:
-        val = 0x10;
-        break;
-    case 0x23:
-        val = 0x20;
-        break;
-    case 0x25:
-        val = 0x30;
-        break;
+    if (n <= 1)
+        return raw;
+
+    fan->rpm_hist[fan->rpm_hist_pos] = raw;
+    fan->rpm_hist_pos = (fan->rpm_hist_pos + 1) % n;
+    if (fan->rpm_hist_len < n)
+        fan->rpm_hist_len++;
+
+    // insertion sort, the window is tiny
+    n = fan->rpm_hist_len;
+    for (i = 0; i < n; i++) {
+        u16 v = fan->rpm_hist[i];
+
+        for (j = i; j > 0 && sorted[j - 1] > v; j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = v;
     }
+    return sorted[n / 2];
+}
 
-    switch (level) {
-    case 0:
-        val += 0x7;
-        break;
-    case 1:
-        val += 0x2;
-        break;
-    case 2:
-        val += 0x3;
-        break;
-    case 3:
-        val += 0x4;
-        break;
-    case 4:
-        val += 0x5;
-        break;
-    case 5:
-    default:
-        val += 0x6;
+// A fan that should turn (level > 0) but reads 0 rpm for EC_FAN_SETTLE_MS
+// is reported as failed, and the speed a fan settles at on each level is
+// learned for hwmon fanN_target. Caller holds ec_lock.
+#define EC_FAN_SETTLE_MS 5000
+
+static void fan_track(struct ec_fan *fan)
+{
+    unsigned long settle  = msecs_to_jiffies(EC_FAN_SETTLE_MS);
+    u16          *learned = &fan->level_rpm[min_t(u8, fan->level, 5)];
+
+    if (fan->level != fan->tracked_level || !fan->level_since) {
+        fan->tracked_level = fan->level;
+        fan->level_since   = jiffies | 1;
+    }
+
+    if (fan->level && !fan->rpm) {
+        if (!fan->stall_since)
+            fan->stall_since = jiffies | 1;
+    } else {
+        fan->stall_since = 0;
     }
+    fan->fault = fan->stall_since &&
+                 time_after_eq(jiffies, fan->stall_since + settle);
 
-    // TODO: handle error
-    ec_write(fan->mode_reg + 1, val);
+    // once the fan had the time to reach the speed of its level
+    if (fan->rpm && time_after_eq(jiffies, fan->level_since + settle))
+        *learned = *learned ? (*learned * 3 + fan->rpm) / 4 : fan->rpm;
 }
 
-static ssize_t fan_level_store(struct device           *dev,
-                               struct device_attribute *attr, const char *buf,
-                               size_t count)
+// Reads all known registers into the snapshot. Caller holds ec_lock.
+static int ec_snapshot_refresh(void)
 {
-    struct ec_fan *fan = dev_get_drvdata(dev);
-    u8             val;
+    unsigned long period = msecs_to_jiffies(shadow_resync_ms);
+    unsigned long next   = ec_shadow_synced + period;
+    bool          resync = !period || time_after_eq(jiffies, next);
+    int           i;
+    int           ret;
+    u8            val;
 
-    if (kstrtou8(buf, 10, &val))
-        return -EINVAL;
+    ec_snapshot_valid = false;
+
+    for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+        struct ec_fan *fan = &ec_fans[i];
 
-    write_fan_level(fan, val);
+        ret = read_fan_rpm(fan, &fan->rpm_raw);
+        if (ret)
+            return ret;
+        fan->rpm = fan_rpm_filter(fan, fan->rpm_raw);
+
+        ret = ec_shadow_read(fan->mode_reg, &val, resync);
+        if (ret)
+            return ret;
+        update_fan_mode(fan, val);
+
+        // in auto mode the firmware changes the level itself
+        ret = ec_shadow_read(fan->mode_reg + 1, &val,
+                             resync || fan->mode == AUTO);
+        if (ret)
+            return ret;
+        fan->level = decode_fan_level(val);
+        fan_track(fan);
+    }
 
-    return count;
+    ret = ec_su_read(ec_temp.reg, &ec_temp.temp);
+    if (ret)
+        return ret;
+
+    // Update min/max
+    if (ec_temp.temp_min == 0 || ec_temp.temp < ec_temp.temp_min)
+        ec_temp.temp_min = ec_temp.temp;
+
+    if (ec_temp.temp > ec_temp.temp_max)
+        ec_temp.temp_max = ec_temp.temp;
+
+    ret = ec_shadow_read(ec_apu.power_mode_reg, &ec_apu.power_mode, resync);
+    if (ret)
+        return ret;
+
+    if (resync)
+        ec_shadow_synced = jiffies;
+    ec_snapshot_stamp = jiffies;
+    ec_snapshot_time  = ktime_get_ns();
+    ec_snapshot_seq++;
+    ec_snapshot_valid = true;
+
+    if (window_stats) {
+        u64 now_ms = div_u64(ec_snapshot_time, NSEC_PER_MSEC);
+
+        ec_series_add(&ec_temp.series, ec_temp.temp, now_ms);
+        for (i = 0; i < ARRAY_SIZE(ec_fans); i++)
+            ec_series_add(&ec_fans[i].series, ec_fans[i].rpm, now_ms);
+    }
+    return 0;
 }
 
-static struct device_attribute dev_attr_fan_level =
-    __ATTR(level, 0644, fan_level_show, fan_level_store);
+static void ec_live_publish(void);
 
-static ssize_t fan_mode_store(struct device *dev, struct device_attribute *attr,
-                              const char *buf, size_t count)
+// Refreshes the snapshot if it is older than snapshot_max_age_ms.
+// Caller holds ec_lock.
+static int ec_snapshot_update(void)
 {
-    struct ec_fan *fan = dev_get_drvdata(dev);
-    u8             val;
+    unsigned long max_age = msecs_to_jiffies(snapshot_max_age_ms);
+    int           ret;
 
-    if (sysfs_streq(buf, "auto")) {
-        fan->mode = AUTO;
-    } else if (sysfs_streq(buf, "fixed")) {
-        fan->mode = FIXED;
-    } else if (sysfs_streq(buf, "curve")) {
-        fan->mode = CURVE;
-    } else {
-        return -EINVAL;
-    }
+    if (ec_snapshot_valid && time_before(jiffies, ec_snapshot_stamp + max_age))
+        return 0;
 
-    switch (fan->mode) {
-    case AUTO:
-        fan->mode = AUTO;
-        switch (fan->mode_reg) {
-        case 0x21:
-            val = 0x10;
-            break;
-        case 0x23:
-            val = 0x20;
-            break;
-        case 0x25:
-            val = 0x30;
-            break;
-        default:
-            return -EINVAL;
-        }
-        break;
-    case FIXED:
-    case CURVE:
-        switch (fan->mode_reg) {
+    ret = ec_snapshot_refresh();
+    if (ret == 0)
+        ec_live_publish();
+    return ret;
+}
+
+static int ec_snapshot_get(void)
+{
+    int ret;
+
+    mutex_lock(&ec_lock);
+    ret = ec_snapshot_update();
+    mutex_unlock(&ec_lock);
+
+    return ret;
+}
+
+// ec_update_worker() runs every interval_min_ms to interval_max_ms: fast
+// while the temperature moves or a fan ramps, backing off while everything is
+// stable. It uses a deferrable timer, and with idle_stop it stops when no fan
+// is in curve mode and no /dev node is open, until one of those changes.
+
+static unsigned int interval_min_ms = 250;
+module_param(interval_min_ms, uint, 0644);
+MODULE_PARM_DESC(interval_min_ms,
+                 "Worker interval in ms while temperature or fan levels are "
+                 "changing (default: 250, min: 50)");
+
+static unsigned int interval_max_ms = 2000;
+module_param(interval_max_ms, uint, 0644);
+MODULE_PARM_DESC(interval_max_ms,
+                 "Worker interval in ms while everything is stable "
+                 "(default: 2000)");
+
+static unsigned int fast_temp_rate = 1;
+module_param(fast_temp_rate, uint, 0644);
+MODULE_PARM_DESC(fast_temp_rate,
+                 "Temperature change in °C/s that switches the worker to "
+                 "interval_min_ms (default: 1)");
+
+static bool ec_worker_ready;
+
+static bool idle_stop = true;
+module_param_cb(idle_stop, &ec_worker_param_ops, &idle_stop, 0644);
+MODULE_PARM_DESC(idle_stop,
+                 "Stop the worker while no fan is in curve mode, no /dev "
+                 "node is open, no attribute is polled and window_stats is "
+                 "off (default: Y)");
+
+static struct delayed_work ec_update_work;
+static unsigned int        ec_interval_ms;
+static atomic_t            ec_consumers = ATOMIC_INIT(0);
+
+static void ec_worker_kick(void)
+{
+    if (ec_worker_ready)
+        mod_delayed_work(system_power_efficient_wq, &ec_update_work, 0);
+}
+
+// Setter of the bool params that decide whether the worker runs.
+static int ec_worker_param_set(const char *val, const struct kernel_param *kp)
+{
+    int ret = param_set_bool(val, kp);
+
+    if (ret == 0)
+        ec_worker_kick();
+    return ret;
+}
+
+// open /dev nodes keep the worker running
+static void ec_consumer_get(void)
+{
+    if (atomic_inc_return(&ec_consumers) == 1)
+        ec_worker_kick();
+}
+
+static void ec_consumer_put(void)
+{
+    atomic_dec(&ec_consumers);
+}
+
+// The driver cannot see poll() waiters on its sysfs attributes. A read of a
+// notified attribute (rpm, level, mode, temp, min, max, power_mode) holds the
+// worker for EC_POLL_LEASE_MS, and before the worker goes idle it notifies all
+// of them once: a poller wakes up, re-reads and so renews the lease and
+// restarts the worker, while a one-off reader lets the lease run out.
+#define EC_POLL_LEASE_MS 10000
+
+static unsigned long ec_poll_lease; // jiffies
+static bool          ec_worker_idle;
+
+static void ec_poll_reader(void)
+{
+    WRITE_ONCE(ec_poll_lease, jiffies + msecs_to_jiffies(EC_POLL_LEASE_MS));
+    if (READ_ONCE(ec_worker_idle))
+        ec_worker_kick();
+}
+
+static bool ec_worker_needed(void)
+{
+    int i;
+
+    if (!idle_stop || window_stats || atomic_read(&ec_consumers) ||
+        time_before(jiffies, READ_ONCE(ec_poll_lease)))
+        return true;
+
+    for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+        if (ec_fans[i].mode == CURVE)
+            return true;
+    }
+    return false;
+}
+
+static ssize_t fan_rpm_show(struct device *dev, struct device_attribute *attr,
+                            char *buf)
+{
+    struct ec_fan *fan = dev_get_drvdata(dev);
+    int            ret;
+
+    ec_poll_reader();
+    ret = ec_snapshot_get();
+    if (ret)
+        return ret;
+
+    return sprintf(buf, "%u\n", fan->rpm);
+}
+
+static struct device_attribute dev_attr_fan_rpm =
+    __ATTR(rpm, 0444, fan_rpm_show, NULL);
+
+static ssize_t fan_rpm_raw_show(struct device           *dev,
+                                struct device_attribute *attr, char *buf)
+{
+    struct ec_fan *fan = dev_get_drvdata(dev);
+    int            ret;
+
+    ret = ec_snapshot_get();
+    if (ret)
+        return ret;
+
+    return sprintf(buf, "%u\n", fan->rpm_raw);
+}
+
+static struct device_attribute dev_attr_fan_rpm_raw =
+    __ATTR(rpm_raw, 0444, fan_rpm_raw_show, NULL);
+
+static ssize_t fan_rpm_filter_show(struct device           *dev,
+                                   struct device_attribute *attr, char *buf)
+{
+    struct ec_fan *fan = dev_get_drvdata(dev);
+    return sprintf(buf, "%u\n", READ_ONCE(fan->rpm_filter));
+}
+
+static ssize_t fan_rpm_filter_store(struct device           *dev,
+                                    struct device_attribute *attr,
+                                    const char *buf, size_t count)
+{
+    struct ec_fan *fan = dev_get_drvdata(dev);
+    u8             val;
+
+    if (kstrtou8(buf, 10, &val) || val > EC_RPM_FILTER_MAX)
+        return -EINVAL;
+
+    mutex_lock(&ec_lock);
+    fan->rpm_filter   = val;
+    fan->rpm_hist_len = 0;
+    fan->rpm_hist_pos = 0;
+    mutex_unlock(&ec_lock);
+
+    return count;
+}
+
+static struct device_attribute dev_attr_fan_rpm_filter =
+    __ATTR(rpm_filter, 0644, fan_rpm_filter_show, fan_rpm_filter_store);
+
+// set once the thermal zone and the cooling devices are registered
+static bool ec_thermal_ready;
+
+static const char *fan_mode_name(enum fan_mode mode)
+{
+    switch (mode) {
+    case AUTO:
+        return "auto";
+    case FIXED:
+        return "fixed";
+    case CURVE:
+        return "curve";
+    case THERMAL:
+        return "thermal";
+    }
+    return "unknown";
+}
+
+static int fan_mode_parse(const char *buf, enum fan_mode *mode)
+{
+    if (sysfs_streq(buf, "auto")) {
+        *mode = AUTO;
+    } else if (sysfs_streq(buf, "fixed")) {
+        *mode = FIXED;
+    } else if (sysfs_streq(buf, "curve")) {
+        *mode = CURVE;
+    } else if (sysfs_streq(buf, "thermal") && ec_thermal_ready) {
+        // rejected up front, so a profile cannot carry it either
+        *mode = THERMAL;
+    } else {
+        return -EINVAL;
+    }
+    return 0;
+}
+
+// Mode register value that selects mode on this fan.
+static int fan_mode_reg_value(const struct ec_fan *fan, enum fan_mode mode,
+                              u8 *val)
+{
+    switch (mode) {
+    case AUTO:
+        switch (fan->mode_reg) {
         case 0x21:
-            val = 0x11;
-            break;
+            *val = 0x10;
+            return 0;
         case 0x23:
-            val = 0x21;
-            break;
+            *val = 0x20;
+            return 0;
         case 0x25:
-            val = 0x31;
+            *val = 0x30;
+            return 0;
+        }
+        break;
+    case THERMAL:
+        if (!ec_thermal_ready)
             break;
-        default:
-            return -EINVAL;
+        fallthrough;
+    case FIXED:
+    case CURVE:
+        switch (fan->mode_reg) {
+        case 0x21:
+            *val = 0x11;
+            return 0;
+        case 0x23:
+            *val = 0x21;
+            return 0;
+        case 0x25:
+            *val = 0x31;
+            return 0;
         }
         break;
     }
+    return -EINVAL;
+}
+
+static ssize_t fan_mode_show(struct device *dev, struct device_attribute *attr,
+                             char *buf)
+{
+    struct ec_fan *fan = dev_get_drvdata(dev);
+    int            ret;
+
+    ec_poll_reader();
+    ret = ec_snapshot_get();
+    if (ret)
+        return ret;
+
+    return sprintf(buf, "%s\n", fan_mode_name(fan->mode));
+}
+
+static ssize_t fan_level_show(struct device *dev, struct device_attribute *attr,
+                              char *buf)
+{
+    struct ec_fan *fan = dev_get_drvdata(dev);
+    int            ret;
+
+    ec_poll_reader();
+    ret = ec_snapshot_get();
+    if (ret)
+        return ret;
+
+    return sprintf(buf, "%u\n", fan->level);
+}
+
+// Stages a level in the shadow; the caller flushes it. Caller holds ec_lock.
+static void write_fan_level(struct ec_fan *fan, u8 level)
+{
+    u8 val;
+
+    switch (fan->mode_reg) {
+    case 0x21:
+        val = 0x10;
+        break;
+    case 0x23:
+        val = 0x20;
+        break;
+    case 0x25:
+        val = 0x30;
+        break;
+    }
+
+    switch (level) {
+    case 0:
+        val += 0x7;
+        break;
+    case 1:
+        val += 0x2;
+        break;
+    case 2:
+        val += 0x3;
+        break;
+    case 3:
+        val += 0x4;
+        break;
+    case 4:
+        val += 0x5;
+        break;
+    case 5:
+    default:
+        val += 0x6;
+    }
+
+    ec_shadow_set(fan->mode_reg + 1, val);
+    fan->level = decode_fan_level(val);
+}
+
+// Sets the level right away, for the class attribute and hwmon pwmN.
+static int fan_set_level(struct ec_fan *fan, u8 level)
+{
+    u8  old;
+    int ret;
+
+    mutex_lock(&ec_lock);
+    old = fan->level;
+    write_fan_level(fan, level);
+    ret = ec_shadow_flush();
+    // the failed register is re-read on the next refresh
+    if (ret)
+        fan->level = old;
+    mutex_unlock(&ec_lock);
+    if (!ret)
+        ec_profile_clear();
+
+    return ret;
+}
+
+static ssize_t fan_level_store(struct device           *dev,
+                               struct device_attribute *attr, const char *buf,
+                               size_t count)
+{
+    struct ec_fan *fan = dev_get_drvdata(dev);
+    u8             val;
+    int            ret;
+
+    if (kstrtou8(buf, 10, &val))
+        return -EINVAL;
+
+    ret = fan_set_level(fan, val);
+    return ret ? ret : count;
+}
+
+static struct device_attribute dev_attr_fan_level =
+    __ATTR(level, 0644, fan_level_show, fan_level_store);
+
+static DEFINE_MUTEX(ec_config_lock);
+
+// Curves must rise with the level and a level must ramp down at or below
+// the temperature it ramps up at.
+static bool fan_config_valid(const struct ec_fan_config *cfg)
+{
+    int i;
+
+    for (i = 1; i < 6; i++) {
+        if (cfg->rampup_curve[i] < cfg->rampup_curve[i - 1] ||
+            cfg->rampdown_curve[i] < cfg->rampdown_curve[i - 1] ||
+            cfg->rampdown_curve[i] > cfg->rampup_curve[i])
+            return false;
+    }
+
+    return cfg->max_step_up >= 1 && cfg->max_step_up <= 5 &&
+           cfg->max_step_down >= 1 && cfg->max_step_down <= 5;
+}
+
+// Makes cfg the fan's config and frees the old one after a grace period.
+// Takes ownership of cfg. Caller holds ec_config_lock.
+static int fan_config_publish(struct ec_fan *fan, struct ec_fan_config *cfg)
+{
+    struct ec_fan_config *old;
+
+    if (!fan_config_valid(cfg)) {
+        kfree(cfg);
+        return -EINVAL;
+    }
+
+    old = rcu_dereference_protected(fan->config,
+                                    lockdep_is_held(&ec_config_lock));
+    rcu_assign_pointer(fan->config, cfg);
+    kfree_rcu(old, rcu);
+    return 0;
+}
+
+// Publishes a copy of the fan's config with len bytes at offset replaced.
+static int fan_config_update(struct ec_fan *fan, size_t offset,
+                             const void *val, size_t len)
+{
+    struct ec_fan_config *cfg;
+    int                   ret;
+
+    mutex_lock(&ec_config_lock);
+    cfg = kmemdup(rcu_dereference_protected(fan->config,
+                                            lockdep_is_held(&ec_config_lock)),
+                  sizeof(*cfg), GFP_KERNEL);
+    if (cfg) {
+        memcpy((u8 *)cfg + offset, val, len);
+        ret = fan_config_publish(fan, cfg);
+    } else {
+        ret = -ENOMEM;
+    }
+    mutex_unlock(&ec_config_lock);
+
+    return ret;
+}
+
+// Copies the fan's current config.
+static void fan_config_get(struct ec_fan *fan, struct ec_fan_config *cfg)
+{
+    rcu_read_lock();
+    *cfg = *rcu_dereference(fan->config);
+    rcu_read_unlock();
+}
+
+// Highest level whose rampup threshold the temperature has reached.
+static u8 fan_curve_level(const struct ec_fan_config *cfg, u8 temp)
+{
+    int i;
+
+    for (i = 5; i > 0; i--) {
+        if (temp >= cfg->rampup_curve[i])
+            return i;
+    }
+    return 0;
+}
+
+// Level the curve controller wants for this tick.
+static u8 fan_curve_target(struct ec_fan *fan, const struct ec_fan_config *cfg,
+                           u8 temp)
+{
+    u8 level = fan->level;
+    u8 target;
+
+    if (cfg->controller == STEP) {
+        if (level < 5 && temp >= cfg->rampup_curve[level + 1])
+            return level + 1;
+        if (level > 0 && temp <= cfg->rampdown_curve[level])
+            return level - 1;
+        return level;
+    }
+
+    // DIRECT: jump up to the level the rampup curve asks for, or down
+    // through every level whose rampdown threshold is reached, limited to
+    // max_step_up/max_step_down levels per tick
+    target = fan_curve_level(cfg, temp);
+    if (target > level)
+        return min(target, (u8)(level + cfg->max_step_up));
+
+    target = level;
+    while (target > 0 && temp <= cfg->rampdown_curve[target])
+        target--;
+    return max_t(int, target, level - cfg->max_step_down);
+}
+
+// Switches the mode, for the class attribute and hwmon pwmN_enable.
+static int fan_set_mode(struct ec_fan *fan, enum fan_mode mode)
+{
+    u8  old;
+    u8  val;
+    int ret;
+
+    if (fan_mode_reg_value(fan, mode, &val))
+        return -EINVAL;
+
+    mutex_lock(&ec_lock);
+    old = fan->level;
+
+    // When switching to CURVE mode, set initial fan level based on current temperature
+    // to prevent RPM burst from inappropriate starting level
+    if (mode == CURVE && ec_snapshot_update() == 0) {
+        // Use rampup curve for initial positioning to be more responsive,
+        // written in the same batch as the mode
+        rcu_read_lock();
+        write_fan_level(fan, fan_curve_level(rcu_dereference(fan->config),
+                                             ec_temp.temp));
+        rcu_read_unlock();
+    } else if (mode == THERMAL) {
+        // the governor's last request, until it makes the next one
+        write_fan_level(fan, fan->cooling_state);
+    }
+    ec_shadow_set(fan->mode_reg, val);
+
+    // on a failure, take over what the EC holds; the failed registers are
+    // re-read on the next refresh
+    ret = ec_shadow_flush();
+    if (!ec_shadow_holds(fan->mode_reg + 1, ec_pending[fan->mode_reg + 1]))
+        fan->level = old;
+    if (!ec_shadow_holds(fan->mode_reg, val))
+        goto out;
+    trace_ec_su_axb35_fan_mode(fan - ec_fans + 1, fan->mode, mode);
+    fan->mode = mode;
+    if (fan->mode == CURVE)
+        ec_worker_kick();
+    ec_profile_clear();
+
+out:
+    mutex_unlock(&ec_lock);
+    return ret;
+}
+
+static ssize_t fan_mode_store(struct device *dev, struct device_attribute *attr,
+                              const char *buf, size_t count)
+{
+    struct ec_fan *fan = dev_get_drvdata(dev);
+    enum fan_mode  mode;
+    int            ret;
+
+    if (fan_mode_parse(buf, &mode))
+        return -EINVAL;
+
+    ret = fan_set_mode(fan, mode);
+    return ret ? ret : count;
+}
+
+static struct device_attribute dev_attr_fan_mode =
+    __ATTR(mode, 0644, fan_mode_show, fan_mode_store);
+
+static ssize_t fan_controller_show(struct device           *dev,
+                                   struct device_attribute *attr, char *buf)
+{
+    struct ec_fan       *fan = dev_get_drvdata(dev);
+    struct ec_fan_config cfg;
+
+    fan_config_get(fan, &cfg);
+    return sprintf(buf, "%s\n", cfg.controller == DIRECT ? "direct" : "step");
+}
+
+static ssize_t fan_controller_store(struct device           *dev,
+                                    struct device_attribute *attr,
+                                    const char *buf, size_t count)
+{
+    struct ec_fan      *fan = dev_get_drvdata(dev);
+    enum fan_controller controller;
+    int                 ret;
+
+    if (sysfs_streq(buf, "step")) {
+        controller = STEP;
+    } else if (sysfs_streq(buf, "direct")) {
+        controller = DIRECT;
+    } else {
+        return -EINVAL;
+    }
+
+    ret = fan_config_update(fan, offsetof(struct ec_fan_config, controller),
+                            &controller, sizeof(controller));
+    return ret ? ret : count;
+}
+
+static struct device_attribute dev_attr_fan_controller =
+    __ATTR(controller, 0644, fan_controller_show, fan_controller_store);
+
+static ssize_t fan_max_step_store(struct ec_fan *fan, size_t offset,
+                                  const char *buf, size_t count)
+{
+    u8  val;
+    int ret;
+
+    if (kstrtou8(buf, 10, &val) || val < 1 || val > 5)
+        return -EINVAL;
+
+    ret = fan_config_update(fan, offset, &val, sizeof(val));
+    return ret ? ret : count;
+}
+
+static ssize_t fan_max_step_up_show(struct device           *dev,
+                                    struct device_attribute *attr, char *buf)
+{
+    struct ec_fan       *fan = dev_get_drvdata(dev);
+    struct ec_fan_config cfg;
+
+    fan_config_get(fan, &cfg);
+    return sprintf(buf, "%u\n", cfg.max_step_up);
+}
+
+static ssize_t fan_max_step_up_store(struct device           *dev,
+                                     struct device_attribute *attr,
+                                     const char *buf, size_t count)
+{
+    struct ec_fan *fan = dev_get_drvdata(dev);
+    return fan_max_step_store(
+        fan, offsetof(struct ec_fan_config, max_step_up), buf, count);
+}
+
+static struct device_attribute dev_attr_fan_max_step_up =
+    __ATTR(max_step_up, 0644, fan_max_step_up_show, fan_max_step_up_store);
+
+static ssize_t fan_max_step_down_show(struct device           *dev,
+                                      struct device_attribute *attr, char *buf)
+{
+    struct ec_fan       *fan = dev_get_drvdata(dev);
+    struct ec_fan_config cfg;
+
+    fan_config_get(fan, &cfg);
+    return sprintf(buf, "%u\n", cfg.max_step_down);
+}
+
+static ssize_t fan_max_step_down_store(struct device           *dev,
+                                       struct device_attribute *attr,
+                                       const char *buf, size_t count)
+{
+    struct ec_fan *fan = dev_get_drvdata(dev);
+    return fan_max_step_store(
+        fan, offsetof(struct ec_fan_config, max_step_down), buf, count);
+}
+
+static struct device_attribute dev_attr_fan_max_step_down = __ATTR(
+    max_step_down, 0644, fan_max_step_down_show, fan_max_step_down_store);
+
+static ssize_t fan_curve_show(struct ec_fan *fan, size_t offset, char *buf)
+{
+    struct ec_fan_config cfg;
+    u8                  *curve = (u8 *)&cfg + offset;
+    int                  i;
+    char                *p = buf;
+
+    fan_config_get(fan, &cfg);
+
+    for (i = 1; i < 6; i++) {
+        p += sprintf(p, "%d", curve[i]);
+        if (i < 5) {
+            *p++ = ',';
+        }
+    }
+    *p++ = '\n';
+    *p   = '\0';
+
+    return p - buf;
+}
+
+// Parses the five comma separated points of a curve. str is modified.
+static int fan_curve_parse(char *str, u8 *curve)
+{
+    char *token;
+    int   values[5];
+    int   i   = 0;
+    int   ret = 0;
+
+    token = strsep(&str, ",");
+    while (token && i < 5) {
+        if (kstrtoint(token, 10, &values[i]) < 0) {
+            ret = -EINVAL;
+            break;
+        }
+        if (values[i] < 0 || values[i] > 100) {
+            ret = -EINVAL;
+            break;
+        }
+        i++;
+        token = strsep(&str, ",");
+    }
+
+    if (i != 5)
+        ret = -EINVAL;
+
+    if (ret == 0) {
+        for (i = 0; i < 5; i++) {
+            curve[i] = values[i];
+        }
+    }
+    return ret;
+}
+
+// Replaces curve points 1-5 at offset in the fan's config as a whole.
+static ssize_t fan_curve_store(struct ec_fan *fan, size_t offset,
+                               const char *buf, size_t count)
+{
+    char *dup = kstrndup(buf, count, GFP_KERNEL);
+    u8    curve[5];
+    int   ret;
+
+    if (!dup)
+        return -ENOMEM;
+
+    ret = fan_curve_parse(dup, curve);
+    if (ret == 0)
+        ret = fan_config_update(fan, offset + 1, curve, sizeof(curve));
+    if (ret == 0)
+        ec_profile_clear();
+
+    kfree(dup);
+    return ret ? ret : count;
+}
+
+static ssize_t fan_rampup_curve_show(struct device           *dev,
+                                     struct device_attribute *attr, char *buf)
+{
+    struct ec_fan *fan = dev_get_drvdata(dev);
+    return fan_curve_show(fan, offsetof(struct ec_fan_config, rampup_curve),
+                          buf);
+}
+
+static ssize_t fan_rampup_curve_store(struct device           *dev,
+                                      struct device_attribute *attr,
+                                      const char *buf, size_t count)
+{
+    struct ec_fan *fan = dev_get_drvdata(dev);
+    return fan_curve_store(
+        fan, offsetof(struct ec_fan_config, rampup_curve), buf, count);
+}
+
+static struct device_attribute dev_attr_fan_rampup_curve =
+    __ATTR(rampup_curve, 0644, fan_rampup_curve_show, fan_rampup_curve_store);
+
+static ssize_t fan_rampdown_curve_show(struct device           *dev,
+                                       struct device_attribute *attr, char *buf)
+{
+    struct ec_fan *fan = dev_get_drvdata(dev);
+    return fan_curve_show(
+        fan, offsetof(struct ec_fan_config, rampdown_curve), buf);
+}
+
+static ssize_t fan_rampdown_curve_store(struct device           *dev,
+                                        struct device_attribute *attr,
+                                        const char *buf, size_t count)
+{
+    struct ec_fan *fan = dev_get_drvdata(dev);
+    return fan_curve_store(
+        fan, offsetof(struct ec_fan_config, rampdown_curve), buf, count);
+}
+
+static struct device_attribute dev_attr_fan_rampdown_curve = __ATTR(
+    rampdown_curve, 0644, fan_rampdown_curve_show, fan_rampdown_curve_store);
+
+static ssize_t temp_current_show(struct device           *dev,
+                                 struct device_attribute *attr, char *buf)
+{
+    struct ec_temp *temp = dev_get_drvdata(dev);
+    int             ret;
+
+    ec_poll_reader();
+    ret = ec_snapshot_get();
+    if (ret)
+        return ret;
+
+    return sprintf(buf, "%u\n", temp->temp);
+}
+
+static struct device_attribute dev_attr_temp_cur =
+    __ATTR(temp, 0444, temp_current_show, NULL);
+
+static ssize_t temp_min_show(struct device *dev, struct device_attribute *attr,
+                             char *buf)
+{
+    struct ec_temp *temp = dev_get_drvdata(dev);
+
+    ec_poll_reader();
+    return sprintf(buf, "%u\n", temp->temp_min);
+}
+
+static struct device_attribute dev_attr_temp_min =
+    __ATTR(min, 0444, temp_min_show, NULL);
+
+static ssize_t temp_max_show(struct device *dev, struct device_attribute *attr,
+                             char *buf)
+{
+    struct ec_temp *temp = dev_get_drvdata(dev);
+
+    ec_poll_reader();
+    return sprintf(buf, "%u\n", temp->temp_max);
+}
+
+static struct device_attribute dev_attr_temp_max =
+    __ATTR(max, 0444, temp_max_show, NULL);
+
+static const char *apu_power_mode_name(u8 val)
+{
+    switch (val) {
+    case 0x00:
+        return "balanced";
+    case 0x01:
+        return "performance";
+    case 0x02:
+        return "quiet";
+    }
+    return NULL;
+}
+
+static int apu_power_mode_parse(const char *buf, u8 *val)
+{
+    if (sysfs_streq(buf, "balanced")) {
+        *val = 0x00;
+    } else if (sysfs_streq(buf, "performance")) {
+        *val = 0x01;
+    } else if (sysfs_streq(buf, "quiet")) {
+        *val = 0x02;
+    } else {
+        return -EINVAL;
+    }
+    return 0;
+}
+
+static ssize_t apu_power_mode_show(struct device           *dev,
+                                   struct device_attribute *attr, char *buf)
+{
+    struct ec_apu *apu = dev_get_drvdata(dev);
+    const char    *mode;
+    int            ret;
+
+    ec_poll_reader();
+    ret = ec_snapshot_get();
+    if (ret)
+        return ret;
+
+    mode = apu_power_mode_name(apu->power_mode);
+    if (!mode)
+        return -EINVAL;
+
+    return sprintf(buf, "%s\n", mode);
+}
+
+// Sets the power mode, for the class attribute and platform_profile.
+static int apu_set_power_mode(u8 val)
+{
+    int ret;
+
+    mutex_lock(&ec_lock);
+    ec_shadow_set(ec_apu.power_mode_reg, val);
+    ret = ec_shadow_flush();
+    if (!ret) {
+        trace_ec_su_axb35_power_mode(ec_apu.power_mode, val);
+        ec_apu.power_mode = val;
+    }
+    mutex_unlock(&ec_lock);
+
+    return ret;
+}
+
+static void ec_platform_profile_notify(void);
+
+static ssize_t apu_power_mode_store(struct device           *dev,
+                                    struct device_attribute *attr,
+                                    const char *buf, size_t count)
+{
+    u8  val;
+    int ret;
+
+    if (apu_power_mode_parse(buf, &val))
+        return -EINVAL;
+
+    ret = apu_set_power_mode(val);
+    if (ret)
+        return ret;
+
+    ec_profile_clear();
+    ec_platform_profile_notify();
+    return count;
+}
+
+static struct device_attribute dev_attr_apu_power_mode =
+    __ATTR(power_mode, 0644, apu_power_mode_show, apu_power_mode_store);
+
+// Profiles bundle the power mode and each fan's mode, fixed level and
+// curves. apu/profiles defines them, one per write:
+//   NAME [power_mode=M] [fanN_mode=M] [fanN_level=L] [fanN_rampup_curve=C]
+//        [fanN_rampdown_curve=C]...
+// Settings that are left out are taken from the current state, so writing
+// just NAME saves the current setup, and -NAME removes a profile. Writing a
+// name to apu/profile applies it: all mode, level and power mode registers
+// go out in one shadow flush, and each fan's curves are published together
+// with its mode, so a tick never sees one without the other. The
+// table and ec_profile_active are protected by ec_config_lock.
+
+#define EC_PROFILES         8
+#define EC_PROFILE_NAME_LEN 16
+
+struct ec_profile_fan {
+    enum fan_mode mode;
+    u8            level;
+    u8            rampup_curve[6];
+    u8            rampdown_curve[6];
+};
+
+struct ec_profile {
+    char                  name[EC_PROFILE_NAME_LEN]; // empty = unused
+    u8                    power_mode;
+    struct ec_profile_fan fan[ARRAY_SIZE(ec_fans)];
+};
+
+static struct ec_profile ec_profiles[EC_PROFILES];
+
+// Caller holds ec_config_lock.
+static struct ec_profile *ec_profile_find(const char *name)
+{
+    int i;
+
+    for (i = 0; i < EC_PROFILES; i++) {
+        if (ec_profiles[i].name[0] && sysfs_streq(ec_profiles[i].name, name))
+            return &ec_profiles[i];
+    }
+    return NULL;
+}
+
+static bool ec_profile_name_valid(const char *name)
+{
+    size_t len = strlen(name);
+    size_t i;
+
+    if (!len || len >= EC_PROFILE_NAME_LEN)
+        return false;
+    for (i = 0; i < len; i++) {
+        if (!isalnum(name[i]) && name[i] != '_' && name[i] != '-')
+            return false;
+    }
+    return strcmp(name, "none") != 0;
+}
+
+// Fills p with the current settings.
+static int ec_profile_capture(struct ec_profile *p)
+{
+    int i;
+    int ret;
+
+    mutex_lock(&ec_lock);
+    ret = ec_snapshot_update();
+    if (ret == 0) {
+        p->power_mode = ec_apu.power_mode;
+        for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+            p->fan[i].mode  = ec_fans[i].mode;
+            p->fan[i].level = ec_fans[i].level;
+        }
+    }
+    mutex_unlock(&ec_lock);
+    if (ret)
+        return ret;
+
+    for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+        struct ec_fan_config cfg;
+
+        fan_config_get(&ec_fans[i], &cfg);
+        memcpy(p->fan[i].rampup_curve, cfg.rampup_curve,
+               sizeof(cfg.rampup_curve));
+        memcpy(p->fan[i].rampdown_curve, cfg.rampdown_curve,
+               sizeof(cfg.rampdown_curve));
+    }
+    return 0;
+}
+
+// Applies one key=value setting to p. tok is modified.
+static int ec_profile_parse(struct ec_profile *p, char *tok)
+{
+    struct ec_profile_fan *pf;
+    char                  *val = strchr(tok, '=');
+    char                  *key;
+
+    if (!val)
+        return -EINVAL;
+    *val++ = '\0';
+
+    if (strcmp(tok, "power_mode") == 0)
+        return apu_power_mode_parse(val, &p->power_mode);
+
+    // fanN_<attribute>
+    if (strncmp(tok, "fan", 3) != 0 || tok[3] < '1' ||
+        tok[3] > '0' + ARRAY_SIZE(ec_fans) || tok[4] != '_')
+        return -EINVAL;
+    pf  = &p->fan[tok[3] - '1'];
+    key = tok + 5;
+
+    if (strcmp(key, "mode") == 0)
+        return fan_mode_parse(val, &pf->mode);
+    if (strcmp(key, "level") == 0)
+        return kstrtou8(val, 10, &pf->level) || pf->level > 5 ? -EINVAL : 0;
+    if (strcmp(key, "rampup_curve") == 0)
+        return fan_curve_parse(val, pf->rampup_curve + 1);
+    if (strcmp(key, "rampdown_curve") == 0)
+        return fan_curve_parse(val, pf->rampdown_curve + 1);
+    return -EINVAL;
+}
+
+// Writes all registers in one batch, then publishes each fan's curves with
+// its mode. Caller holds ec_config_lock.
+static int ec_profile_apply(const struct ec_profile *p)
+{
+    struct ec_fan_config *cfg[ARRAY_SIZE(ec_fans)];
+    u8                    mode_val[ARRAY_SIZE(ec_fans)];
+    u8                    old_level[ARRAY_SIZE(ec_fans)];
+    bool                  curve = false;
+    bool                  have_temp;
+    int                   i;
+    int                   ret = 0;
+
+    // resolve the mode registers before anything is published or staged,
+    // so an unusable mode leaves the curves and the shadow untouched
+    for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+        if (fan_mode_reg_value(&ec_fans[i], p->fan[i].mode, &mode_val[i]))
+            return -EINVAL;
+    }
+
+    // copy and check everything first; the copies are published only
+    // together with the modes they belong to
+    for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+        cfg[i] = kmemdup(rcu_dereference_protected(
+                             ec_fans[i].config,
+                             lockdep_is_held(&ec_config_lock)),
+                         sizeof(*cfg[i]), GFP_KERNEL);
+        if (cfg[i]) {
+            memcpy(cfg[i]->rampup_curve, p->fan[i].rampup_curve,
+                   sizeof(cfg[i]->rampup_curve));
+            memcpy(cfg[i]->rampdown_curve, p->fan[i].rampdown_curve,
+                   sizeof(cfg[i]->rampdown_curve));
+            // validated when the profile was defined
+            if (!fan_config_valid(cfg[i]))
+                ret = -EINVAL;
+        } else {
+            ret = -ENOMEM;
+        }
+        if (ret) {
+            kfree(cfg[i]);
+            while (i--)
+                kfree(cfg[i]);
+            return ret;
+        }
+    }
+
+    mutex_lock(&ec_lock);
+    have_temp = ec_snapshot_update() == 0;
+
+    for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+        struct ec_fan *fan  = &ec_fans[i];
+        enum fan_mode  mode = p->fan[i].mode;
+
+        old_level[i] = fan->level;
+        // same initial curve level as fan_mode_store()
+        if (mode == FIXED)
+            write_fan_level(fan, p->fan[i].level);
+        else if (mode == CURVE && have_temp)
+            write_fan_level(fan, fan_curve_level(cfg[i], ec_temp.temp));
+        else if (mode == THERMAL)
+            write_fan_level(fan, fan->cooling_state);
+        ec_shadow_set(fan->mode_reg, mode_val[i]);
+    }
+    ec_shadow_set(ec_apu.power_mode_reg, p->power_mode);
+
+    // ascending registers: each fan's mode before its level, then the
+    // power mode
+    ret = ec_shadow_flush();
+
+    // The flush stops at nothing, so on a failure some registers may hold
+    // the new values and others not. Take over what the EC holds, and
+    // publish a fan's curves together with its mode, still under ec_lock so
+    // no tick sees one without the other.
+    for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+        struct ec_fan *fan = &ec_fans[i];
+
+        if (!ec_shadow_holds(fan->mode_reg + 1, ec_pending[fan->mode_reg + 1]))
+            fan->level = old_level[i];
+
+        if (!ec_shadow_holds(fan->mode_reg, mode_val[i])) {
+            kfree(cfg[i]);
+            continue;
+        }
+        fan_config_publish(fan, cfg[i]);
+        if (fan->mode != p->fan[i].mode)
+            trace_ec_su_axb35_fan_mode(i + 1, fan->mode, p->fan[i].mode);
+        fan->mode = p->fan[i].mode;
+        curve |= fan->mode == CURVE;
+    }
+    if (ec_shadow_holds(ec_apu.power_mode_reg, p->power_mode)) {
+        if (ec_apu.power_mode != p->power_mode)
+            trace_ec_su_axb35_power_mode(ec_apu.power_mode, p->power_mode);
+        ec_apu.power_mode = p->power_mode;
+    }
+    if (curve)
+        ec_worker_kick();
+
+    mutex_unlock(&ec_lock);
+    return ret;
+}
+
+static ssize_t apu_profile_show(struct device           *dev,
+                                struct device_attribute *attr, char *buf)
+{
+    int active = READ_ONCE(ec_profile_active);
+    int ret;
+
+    mutex_lock(&ec_config_lock);
+    ret = sprintf(buf, "%s\n",
+                  active >= 0 ? ec_profiles[active].name : "none");
+    mutex_unlock(&ec_config_lock);
+
+    return ret;
+}
+
+static ssize_t apu_profile_store(struct device           *dev,
+                                 struct device_attribute *attr,
+                                 const char *buf, size_t count)
+{
+    struct ec_profile *p;
+    int                ret;
+
+    mutex_lock(&ec_config_lock);
+    p = ec_profile_find(buf);
+    if (p) {
+        ret = ec_profile_apply(p);
+        WRITE_ONCE(ec_profile_active, ret ? -1 : p - ec_profiles);
+    } else {
+        ret = -ENOENT;
+    }
+    mutex_unlock(&ec_config_lock);
+    ec_platform_profile_notify();
+
+    return ret ? ret : count;
+}
+
+static struct device_attribute dev_attr_apu_profile =
+    __ATTR(profile, 0644, apu_profile_show, apu_profile_store);
+
+static ssize_t apu_profiles_show(struct device           *dev,
+                                 struct device_attribute *attr, char *buf)
+{
+    ssize_t len = 0;
+    int     i;
+    int     j;
+
+    mutex_lock(&ec_config_lock);
+    for (i = 0; i < EC_PROFILES; i++) {
+        const struct ec_profile *p = &ec_profiles[i];
+
+        if (!p->name[0])
+            continue;
+
+        len += scnprintf(buf + len, PAGE_SIZE - len, "%s power_mode=%s",
+                         p->name, apu_power_mode_name(p->power_mode));
+        for (j = 0; j < ARRAY_SIZE(ec_fans); j++) {
+            const struct ec_profile_fan *pf = &p->fan[j];
+            const u8                    *up = pf->rampup_curve;
+            const u8                    *dn = pf->rampdown_curve;
+
+            len += scnprintf(
+                buf + len, PAGE_SIZE - len,
+                " fan%d_mode=%s fan%d_level=%u"
+                " fan%d_rampup_curve=%u,%u,%u,%u,%u"
+                " fan%d_rampdown_curve=%u,%u,%u,%u,%u",
+                j + 1, fan_mode_name(pf->mode), j + 1, pf->level, j + 1, up[1],
+                up[2], up[3], up[4], up[5], j + 1, dn[1], dn[2], dn[3], dn[4],
+                dn[5]);
+        }
+        len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+    }
+    mutex_unlock(&ec_config_lock);
+
+    return len;
+}
+
+static ssize_t apu_profiles_store(struct device           *dev,
+                                  struct device_attribute *attr,
+                                  const char *buf, size_t count)
+{
+    struct ec_profile  p = {};
+    struct ec_profile *slot;
+    char              *dup = kstrndup(buf, count, GFP_KERNEL);
+    char              *str = dup;
+    char              *name;
+    char              *tok;
+    int                i;
+    int                ret = 0;
+
+    if (!dup)
+        return -ENOMEM;
+
+    name = strsep(&str, " \t\n");
+
+    // -NAME removes a profile
+    if (name[0] == '-') {
+        mutex_lock(&ec_config_lock);
+        slot = ec_profile_find(name + 1);
+        if (slot) {
+            if (READ_ONCE(ec_profile_active) == slot - ec_profiles)
+                ec_profile_clear();
+            slot->name[0] = '\0';
+        } else {
+            ret = -ENOENT;
+        }
+        mutex_unlock(&ec_config_lock);
+        goto out;
+    }
+
+    if (!ec_profile_name_valid(name)) {
+        ret = -EINVAL;
+        goto out;
+    }
+    strscpy(p.name, name, sizeof(p.name));
+
+    ret = ec_profile_capture(&p);
+    while (ret == 0 && (tok = strsep(&str, " \t\n")) != NULL) {
+        if (*tok)
+            ret = ec_profile_parse(&p, tok);
+    }
+    if (ret)
+        goto out;
+
+    // validated as a whole, with the controller settings of each fan
+    for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+        struct ec_fan_config cfg;
+
+        fan_config_get(&ec_fans[i], &cfg);
+        memcpy(cfg.rampup_curve, p.fan[i].rampup_curve,
+               sizeof(cfg.rampup_curve));
+        memcpy(cfg.rampdown_curve, p.fan[i].rampdown_curve,
+               sizeof(cfg.rampdown_curve));
+        if (!fan_config_valid(&cfg)) {
+            ret = -EINVAL;
+            goto out;
+        }
+    }
+
+    mutex_lock(&ec_config_lock);
+    slot = ec_profile_find(p.name);
+    for (i = 0; !slot && i < EC_PROFILES; i++) {
+        if (!ec_profiles[i].name[0])
+            slot = &ec_profiles[i];
+    }
+    if (slot) {
+        // a redefined profile is no longer what was applied
+        if (READ_ONCE(ec_profile_active) == slot - ec_profiles)
+            ec_profile_clear();
+        *slot = p;
+    } else {
+        ret = -ENOSPC;
+    }
+    mutex_unlock(&ec_config_lock);
+
+out:
+    kfree(dup);
+    return ret ? ret : count;
+}
+
+static struct device_attribute dev_attr_apu_profiles =
+    __ATTR(profiles, 0644, apu_profiles_show, apu_profiles_store);
+
+// platform_profile: low-power, balanced and performance map to the quiet,
+// balanced and performance power modes, so power-profiles-daemon and desktop
+// toggles can switch them. When a profile (see apu/profiles) with the
+// platform profile's name exists, it is applied with the power mode, so the
+// fan modes and curves change in the same batch; its own power_mode is
+// replaced by the one of the platform profile. Needs the ops based API of
+// 6.14 or later.
+#if IS_ENABLED(CONFIG_ACPI_PLATFORM_PROFILE) && \
+    LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0)
+
+static struct device *ec_pprof_dev;
+static u8             ec_pprof_notified; // power mode last reported
+
+static const struct {
+    enum platform_profile_option profile;
+    const char                  *name;
+    u8                           power_mode;
+} ec_pprof_map[] = {
+    { PLATFORM_PROFILE_LOW_POWER, "low-power", 0x02 },
+    { PLATFORM_PROFILE_BALANCED, "balanced", 0x00 },
+    { PLATFORM_PROFILE_PERFORMANCE, "performance", 0x01 },
+};
+
+static int ec_pprof_probe(void *drvdata, unsigned long *choices)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(ec_pprof_map); i++)
+        set_bit(ec_pprof_map[i].profile, choices);
+    return 0;
+}
+
+static int ec_pprof_get(struct device                *dev,
+                        enum platform_profile_option *profile)
+{
+    int ret;
+    int i;
+
+    ret = ec_snapshot_get();
+    if (ret)
+        return ret;
+
+    for (i = 0; i < ARRAY_SIZE(ec_pprof_map); i++) {
+        if (ec_pprof_map[i].power_mode == ec_apu.power_mode) {
+            *profile = ec_pprof_map[i].profile;
+            return 0;
+        }
+    }
+    return -EINVAL;
+}
+
+static int ec_pprof_set(struct device               *dev,
+                        enum platform_profile_option profile)
+{
+    struct ec_profile *p;
+    int                ret;
+    int                i;
+
+    for (i = 0; i < ARRAY_SIZE(ec_pprof_map); i++) {
+        if (ec_pprof_map[i].profile == profile)
+            break;
+    }
+    if (i == ARRAY_SIZE(ec_pprof_map))
+        return -EOPNOTSUPP;
+
+    mutex_lock(&ec_config_lock);
+    p = ec_profile_find(ec_pprof_map[i].name);
+    if (p) {
+        struct ec_profile bundle = *p;
+
+        bundle.power_mode = ec_pprof_map[i].power_mode;
+        ret               = ec_profile_apply(&bundle);
+        WRITE_ONCE(ec_profile_active, ret ? -1 : p - ec_profiles);
+    } else {
+        ret = apu_set_power_mode(ec_pprof_map[i].power_mode);
+        ec_profile_clear();
+    }
+    mutex_unlock(&ec_config_lock);
+
+    // the platform_profile core notifies about its own changes
+    if (!ret)
+        WRITE_ONCE(ec_pprof_notified, ec_pprof_map[i].power_mode);
+    return ret;
+}
+
+static const struct platform_profile_ops ec_pprof_ops = {
+    .probe       = ec_pprof_probe,
+    .profile_get = ec_pprof_get,
+    .profile_set = ec_pprof_set,
+};
+
+// Reports a power mode change made outside platform_profile: through
+// apu/power_mode, apu/profile or by the firmware. Called without ec_lock and
+// ec_config_lock, as the core calls back into ec_pprof_get() under its own
+// lock.
+static void ec_platform_profile_notify(void)
+{
+    u8 mode = READ_ONCE(ec_apu.power_mode);
+
+    if (!ec_pprof_dev || mode == READ_ONCE(ec_pprof_notified))
+        return;
+
+    WRITE_ONCE(ec_pprof_notified, mode);
+    platform_profile_notify(ec_pprof_dev);
+}
+
+// Not fatal: another driver may have registered a legacy platform profile
+// handler already.
+static void ec_platform_profile_register(struct device *parent)
+{
+    struct device *dev;
+
+    ec_pprof_notified = ec_apu.power_mode;
+    dev = platform_profile_register(parent, "su_axb35", NULL, &ec_pprof_ops);
+    if (IS_ERR(dev)) {
+        pr_warn("ec_su_axb35: Failed to register platform profile (%ld)\n",
+                PTR_ERR(dev));
+        return;
+    }
+    ec_pprof_dev = dev;
+}
+
+static void ec_platform_profile_unregister(void)
+{
+    if (ec_pprof_dev) {
+        platform_profile_remove(ec_pprof_dev);
+        ec_pprof_dev = NULL;
+    }
+}
+
+#else
+
+static void ec_platform_profile_notify(void)
+{
+}
+
+static void ec_platform_profile_register(struct device *parent)
+{
+}
+
+static void ec_platform_profile_unregister(void)
+{
+}
+
+#endif
+
+// stats/ group of temp1 and fanX, one value per window in each attribute
+
+static struct ec_series *ec_series_of(struct device *dev)
+{
+    void *data = dev_get_drvdata(dev);
+
+    if (data == &ec_temp)
+        return &ec_temp.series;
+    return &((struct ec_fan *)data)->series;
+}
+
+// Also restarts the all-time min/max of the temperature.
+static void ec_series_restart(struct ec_series *ser)
+{
+    mutex_lock(&ec_lock);
+    ec_series_reset(ser);
+    if (ser == &ec_temp.series) {
+        ec_temp.temp_min = ec_temp.temp;
+        ec_temp.temp_max = ec_temp.temp;
+    }
+    mutex_unlock(&ec_lock);
+}
+
+static ssize_t ec_series_show(struct device *dev, char *buf, size_t field)
+{
+    struct ec_series *ser    = ec_series_of(dev);
+    u64               now_ms = div_u64(ktime_get_ns(), NSEC_PER_MSEC);
+    int               len    = 0;
+    int               w;
+
+    mutex_lock(&ec_lock);
+    for (w = 0; w < stats_windows_count; w++) {
+        struct ec_window_sum sum;
+
+        ec_window_sum(ser, w, now_ms, &sum);
+        len += sprintf(buf + len, "%s%llu", w ? " " : "",
+                       *(u64 *)((u8 *)&sum + field));
+    }
+    mutex_unlock(&ec_lock);
+
+    len += sprintf(buf + len, "\n");
+    return len;
+}
+
+#define EC_SERIES_ATTR(_name, _field)                                        \
+    static ssize_t series_##_name##_show(                                    \
+        struct device *dev, struct device_attribute *attr, char *buf)        \
+    {                                                                        \
+        return ec_series_show(dev, buf,                                      \
+                              offsetof(struct ec_window_sum, _field));       \
+    }                                                                        \
+    static struct device_attribute dev_attr_series_##_name =                 \
+        __ATTR(_name, 0444, series_##_name##_show, NULL)
+
+EC_SERIES_ATTR(min, min);
+EC_SERIES_ATTR(max, max);
+EC_SERIES_ATTR(mean, mean);
+EC_SERIES_ATTR(ewma, ewma);
+EC_SERIES_ATTR(p95, p95);
+EC_SERIES_ATTR(above_threshold_ms, above_ms);
+
+static ssize_t series_windows_show(struct device           *dev,
+                                   struct device_attribute *attr, char *buf)
+{
+    int len = 0;
+    int w;
+
+    for (w = 0; w < stats_windows_count; w++)
+        len += sprintf(buf + len, "%s%u", w ? " " : "", stats_windows[w]);
+    len += sprintf(buf + len, "\n");
+    return len;
+}
+
+static struct device_attribute dev_attr_series_windows =
+    __ATTR(windows, 0444, series_windows_show, NULL);
+
+static ssize_t series_threshold_show(struct device           *dev,
+                                     struct device_attribute *attr, char *buf)
+{
+    return sprintf(buf, "%u\n", READ_ONCE(ec_series_of(dev)->threshold));
+}
+
+static ssize_t series_threshold_store(struct device           *dev,
+                                      struct device_attribute *attr,
+                                      const char *buf, size_t count)
+{
+    unsigned int val;
+
+    if (kstrtouint(buf, 10, &val))
+        return -EINVAL;
+
+    mutex_lock(&ec_lock);
+    ec_series_of(dev)->threshold = val;
+    mutex_unlock(&ec_lock);
+
+    return count;
+}
+
+static struct device_attribute dev_attr_series_threshold = __ATTR(
+    threshold, 0644, series_threshold_show, series_threshold_store);
+
+static ssize_t series_reset_store(struct device           *dev,
+                                  struct device_attribute *attr,
+                                  const char *buf, size_t count)
+{
+    ec_series_restart(ec_series_of(dev));
+    return count;
+}
+
+static struct device_attribute dev_attr_series_reset =
+    __ATTR(reset, 0200, NULL, series_reset_store);
+
+static struct attribute *ec_series_attrs[] = {
+    &dev_attr_series_windows.attr,
+    &dev_attr_series_min.attr,
+    &dev_attr_series_max.attr,
+    &dev_attr_series_mean.attr,
+    &dev_attr_series_ewma.attr,
+    &dev_attr_series_p95.attr,
+    &dev_attr_series_above_threshold_ms.attr,
+    &dev_attr_series_threshold.attr,
+    &dev_attr_series_reset.attr,
+    NULL,
+};
+
+static const struct attribute_group ec_series_group = {
+    .name  = "stats",
+    .attrs = ec_series_attrs,
+};
+
+// hwmon interface, served from the same snapshot as the class attributes
+
+static umode_t ec_hwmon_is_visible(const void *data,
+                                   enum hwmon_sensor_types type, u32 attr,
+                                   int channel)
+{
+    switch (type) {
+    case hwmon_temp:
+        switch (attr) {
+        case hwmon_temp_input:
+        case hwmon_temp_lowest:
+        case hwmon_temp_highest:
+            return 0444;
+        case hwmon_temp_reset_history:
+            return 0200;
+        }
+        break;
+    case hwmon_fan:
+        switch (attr) {
+        case hwmon_fan_input:
+        case hwmon_fan_label:
+        case hwmon_fan_target:
+        case hwmon_fan_fault:
+            return 0444;
+        }
+        break;
+    case hwmon_pwm:
+        switch (attr) {
+        case hwmon_pwm_input:
+        case hwmon_pwm_enable:
+            return 0644;
+        }
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+// pwmN_enable: 1 = fixed (manual), 2 = auto (firmware), 3 = curve (driver),
+// 4 = thermal (kernel thermal governor)
+static long fan_mode_to_pwm_enable(enum fan_mode mode)
+{
+    switch (mode) {
+    case FIXED:
+        return 1;
+    case AUTO:
+        return 2;
+    case CURVE:
+        return 3;
+    case THERMAL:
+        return 4;
+    }
+    return 0;
+}
+
+// pwm 0-255 in steps of 51 per level
+static long fan_level_to_pwm(u8 level)
+{
+    return DIV_ROUND_CLOSEST(level * 255, 5);
+}
+
+static int ec_hwmon_read(struct device *dev, enum hwmon_sensor_types type,
+                         u32 attr, int channel, long *val)
+{
+    struct ec_fan *fan;
+    int            ret;
+
+    ret = ec_snapshot_get();
+    if (ret)
+        return ret;
+
+    switch (type) {
+    case hwmon_temp:
+        // hwmon reports millidegrees
+        switch (attr) {
+        case hwmon_temp_input:
+            *val = ec_temp.temp * 1000;
+            return 0;
+        case hwmon_temp_lowest:
+            *val = ec_temp.temp_min * 1000;
+            return 0;
+        case hwmon_temp_highest:
+            *val = ec_temp.temp_max * 1000;
+            return 0;
+        }
+        break;
+    case hwmon_fan:
+        if (channel >= ARRAY_SIZE(ec_fans))
+            break;
+        fan = &ec_fans[channel];
+        switch (attr) {
+        case hwmon_fan_input:
+            *val = fan->rpm;
+            return 0;
+        case hwmon_fan_target:
+            // unknown until the fan ran on this level for a while
+            if (fan->level && !fan->level_rpm[min_t(u8, fan->level, 5)])
+                return -ENODATA;
+            *val = fan->level_rpm[min_t(u8, fan->level, 5)];
+            return 0;
+        case hwmon_fan_fault:
+            *val = fan->fault;
+            return 0;
+        }
+        break;
+    case hwmon_pwm:
+        if (channel >= ARRAY_SIZE(ec_fans))
+            break;
+        fan = &ec_fans[channel];
+        switch (attr) {
+        case hwmon_pwm_input:
+            *val = fan_level_to_pwm(fan->level);
+            return 0;
+        case hwmon_pwm_enable:
+            *val = fan_mode_to_pwm_enable(fan->mode);
+            return 0;
+        }
+        break;
+    default:
+        break;
+    }
+    return -EOPNOTSUPP;
+}
+
+static int ec_hwmon_read_string(struct device               *dev,
+                                enum hwmon_sensor_types type, u32 attr,
+                                int channel, const char **str)
+{
+    if (type == hwmon_fan && attr == hwmon_fan_label &&
+        channel < ARRAY_SIZE(ec_fans)) {
+        *str = ec_fans[channel].label;
+        return 0;
+    }
+    return -EOPNOTSUPP;
+}
+
+static int ec_hwmon_write(struct device *dev, enum hwmon_sensor_types type,
+                          u32 attr, int channel, long val)
+{
+    struct ec_fan *fan;
+
+    if (type == hwmon_temp && attr == hwmon_temp_reset_history) {
+        ec_series_restart(&ec_temp.series);
+        return 0;
+    }
+    if (type != hwmon_pwm || channel >= ARRAY_SIZE(ec_fans))
+        return -EOPNOTSUPP;
+    fan = &ec_fans[channel];
+
+    switch (attr) {
+    case hwmon_pwm_input:
+        if (val < 0 || val > 255)
+            return -EINVAL;
+        return fan_set_level(fan, DIV_ROUND_CLOSEST(val * 5, 255));
+    case hwmon_pwm_enable:
+        switch (val) {
+        case 1:
+            return fan_set_mode(fan, FIXED);
+        case 2:
+            return fan_set_mode(fan, AUTO);
+        case 3:
+            return fan_set_mode(fan, CURVE);
+        case 4:
+            return fan_set_mode(fan, THERMAL);
+        }
+        return -EINVAL;
+    }
+    return -EOPNOTSUPP;
+}
+
+// pwmN_auto_pointM_{temp,temp_hyst,pwm}: curve point M of fan N. temp is the
+// rampup threshold of level M, temp - temp_hyst the rampdown threshold, and
+// pwm the level's fixed pwm value. hwmon has no channel info for these, so
+// they are an extra group; nr is the fan, index the point.
+
+static ssize_t ec_auto_point_temp_show(struct device           *dev,
+                                       struct device_attribute *attr,
+                                       char                    *buf)
+{
+    struct sensor_device_attribute_2 *sattr = to_sensor_dev_attr_2(attr);
+    struct ec_fan_config              cfg;
+
+    fan_config_get(&ec_fans[sattr->nr], &cfg);
+    return sprintf(buf, "%u\n", cfg.rampup_curve[sattr->index] * 1000);
+}
+
+static ssize_t ec_auto_point_temp_store(struct device           *dev,
+                                        struct device_attribute *attr,
+                                        const char *buf, size_t count)
+{
+    struct sensor_device_attribute_2 *sattr = to_sensor_dev_attr_2(attr);
+    long                              val;
+    u8                                temp;
+    int                               ret;
+
+    if (kstrtol(buf, 10, &val) || val < 0 || val > 100000)
+        return -EINVAL;
+    temp = DIV_ROUND_CLOSEST(val, 1000);
+
+    ret = fan_config_update(&ec_fans[sattr->nr],
+                            offsetof(struct ec_fan_config, rampup_curve) +
+                                sattr->index,
+                            &temp, sizeof(temp));
+    if (ret == 0)
+        ec_profile_clear();
+    return ret ? ret : count;
+}
+
+static ssize_t ec_auto_point_hyst_show(struct device           *dev,
+                                       struct device_attribute *attr,
+                                       char                    *buf)
+{
+    struct sensor_device_attribute_2 *sattr = to_sensor_dev_attr_2(attr);
+    struct ec_fan_config              cfg;
+
+    fan_config_get(&ec_fans[sattr->nr], &cfg);
+    return sprintf(buf, "%u\n",
+                   (cfg.rampup_curve[sattr->index] -
+                    cfg.rampdown_curve[sattr->index]) *
+                       1000);
+}
+
+static ssize_t ec_auto_point_hyst_store(struct device           *dev,
+                                        struct device_attribute *attr,
+                                        const char *buf, size_t count)
+{
+    struct sensor_device_attribute_2 *sattr = to_sensor_dev_attr_2(attr);
+    struct ec_fan_config              cfg;
+    long                              val;
+    u8                                hyst;
+    u8                                temp;
+    int                               ret;
+
+    if (kstrtol(buf, 10, &val) || val < 0 || val > 100000)
+        return -EINVAL;
+    hyst = DIV_ROUND_CLOSEST(val, 1000);
+
+    fan_config_get(&ec_fans[sattr->nr], &cfg);
+    if (hyst > cfg.rampup_curve[sattr->index])
+        return -EINVAL;
+    temp = cfg.rampup_curve[sattr->index] - hyst;
+
+    ret = fan_config_update(&ec_fans[sattr->nr],
+                            offsetof(struct ec_fan_config, rampdown_curve) +
+                                sattr->index,
+                            &temp, sizeof(temp));
+    if (ret == 0)
+        ec_profile_clear();
+    return ret ? ret : count;
+}
+
+static ssize_t ec_auto_point_pwm_show(struct device           *dev,
+                                      struct device_attribute *attr, char *buf)
+{
+    struct sensor_device_attribute_2 *sattr = to_sensor_dev_attr_2(attr);
+
+    return sprintf(buf, "%ld\n", fan_level_to_pwm(sattr->index));
+}
+
+#define EC_AUTO_POINT(_fan, _point)                                             \
+    static SENSOR_DEVICE_ATTR_2_RW(pwm##_fan##_auto_point##_point##_temp,       \
+                                   ec_auto_point_temp, _fan - 1, _point);       \
+    static SENSOR_DEVICE_ATTR_2_RW(pwm##_fan##_auto_point##_point##_temp_hyst,  \
+                                   ec_auto_point_hyst, _fan - 1, _point);       \
+    static SENSOR_DEVICE_ATTR_2_RO(pwm##_fan##_auto_point##_point##_pwm,        \
+                                   ec_auto_point_pwm, _fan - 1, _point)
+
+#define EC_AUTO_POINTS(_fan)                                                    \
+    EC_AUTO_POINT(_fan, 1);                                                     \
+    EC_AUTO_POINT(_fan, 2);                                                     \
+    EC_AUTO_POINT(_fan, 3);                                                     \
+    EC_AUTO_POINT(_fan, 4);                                                     \
+    EC_AUTO_POINT(_fan, 5)
+
+EC_AUTO_POINTS(1);
+EC_AUTO_POINTS(2);
+EC_AUTO_POINTS(3);
+
+#define EC_AUTO_POINT_ATTRS(_fan, _point)                                       \
+    &sensor_dev_attr_pwm##_fan##_auto_point##_point##_temp.dev_attr.attr,       \
+        &sensor_dev_attr_pwm##_fan##_auto_point##_point##_temp_hyst.dev_attr    \
+             .attr,                                                             \
+        &sensor_dev_attr_pwm##_fan##_auto_point##_point##_pwm.dev_attr.attr
+
+#define EC_AUTO_POINTS_ATTRS(_fan)                                              \
+    EC_AUTO_POINT_ATTRS(_fan, 1), EC_AUTO_POINT_ATTRS(_fan, 2),                 \
+        EC_AUTO_POINT_ATTRS(_fan, 3), EC_AUTO_POINT_ATTRS(_fan, 4),             \
+        EC_AUTO_POINT_ATTRS(_fan, 5)
+
+static struct attribute *ec_hwmon_auto_point_attrs[] = {
+    EC_AUTO_POINTS_ATTRS(1),
+    EC_AUTO_POINTS_ATTRS(2),
+    EC_AUTO_POINTS_ATTRS(3),
+    NULL
+};
+
+ATTRIBUTE_GROUPS(ec_hwmon_auto_point);
+
+// Thermal framework. The EC temperature is registered as a thermal zone with
+// an active and a passive trip, and each fan as a cooling device with one
+// state per level, so a governor can drive the fans, and optionally CPU
+// throttling, from the same zone. A cooling device only moves its fan in
+// thermal mode; in the other modes the governor's request is remembered and
+// applied when the fan is switched to thermal. Binding relies on
+// should_bind(), so this needs 6.12 or later.
+#if IS_ENABLED(CONFIG_THERMAL) && \
+    LINUX_VERSION_CODE >= KERNEL_VERSION(6, 12, 0)
+
+static unsigned int thermal_active_temp = 60;
+module_param(thermal_active_temp, uint, 0444);
+MODULE_PARM_DESC(thermal_active_temp,
+                 "Active trip of the thermal zone in °C, where the governor "
+                 "starts the fans (default: 60)");
+
+static unsigned int thermal_passive_temp = 85;
+module_param(thermal_passive_temp, uint, 0444);
+MODULE_PARM_DESC(thermal_passive_temp,
+                 "Passive trip of the thermal zone in °C (default: 85)");
+
+static unsigned int thermal_poll_ms = 1000;
+module_param(thermal_poll_ms, uint, 0444);
+MODULE_PARM_DESC(thermal_poll_ms,
+                 "Polling interval of the thermal zone in ms (default: 1000)");
+
+static bool thermal_cpu;
+module_param(thermal_cpu, bool, 0444);
+MODULE_PARM_DESC(thermal_cpu,
+                 "Bind the processor cooling devices to the passive trip "
+                 "(default: off)");
+
+static struct thermal_zone_device    *ec_thermal_zone;
+static struct thermal_cooling_device *ec_cooling_devs[ARRAY_SIZE(ec_fans)];
+
+static const struct thermal_cooling_device_ops ec_cooling_ops;
+
+static int ec_thermal_get_temp(struct thermal_zone_device *tz, int *temp)
+{
+    int ret;
+
+    ret = ec_snapshot_get();
+    if (ret)
+        return ret;
+
+    *temp = ec_temp.temp * 1000;
+    return 0;
+}
+
+// Fans on both trips over their full range; processor cooling devices
+// (ACPI processor or cpufreq) on the passive trip with thermal_cpu.
+static bool ec_thermal_should_bind(struct thermal_zone_device   *tz,
+                                   const struct thermal_trip     *trip,
+                                   struct thermal_cooling_device *cdev,
+                                   struct cooling_spec           *c)
+{
+    if (cdev->ops == &ec_cooling_ops)
+        return trip->type == THERMAL_TRIP_ACTIVE ||
+               trip->type == THERMAL_TRIP_PASSIVE;
+
+    return thermal_cpu && trip->type == THERMAL_TRIP_PASSIVE &&
+           (!strcmp(cdev->type, "Processor") ||
+            !strncmp(cdev->type, "cpufreq-", 8));
+}
+
+static const struct thermal_zone_device_ops ec_thermal_ops = {
+    .get_temp    = ec_thermal_get_temp,
+    .should_bind = ec_thermal_should_bind,
+};
+
+static int ec_cooling_get_max_state(struct thermal_cooling_device *cdev,
+                                    unsigned long                 *state)
+{
+    *state = 5;
+    return 0;
+}
+
+static int ec_cooling_get_cur_state(struct thermal_cooling_device *cdev,
+                                    unsigned long                 *state)
+{
+    struct ec_fan *fan = cdev->devdata;
+    int            ret;
+
+    ret = ec_snapshot_get();
+    if (ret)
+        return ret;
+
+    *state = fan->mode == THERMAL ? fan->level : fan->cooling_state;
+    return 0;
+}
+
+static int ec_cooling_set_cur_state(struct thermal_cooling_device *cdev,
+                                    unsigned long                  state)
+{
+    struct ec_fan *fan = cdev->devdata;
+    int            ret = 0;
+
+    if (state > 5)
+        return -EINVAL;
+
+    mutex_lock(&ec_lock);
+    fan->cooling_state = state;
+    if (fan->mode == THERMAL && fan->level != state) {
+        u8 old = fan->level;
+
+        write_fan_level(fan, state);
+        ret = ec_shadow_flush();
+        // keep the level the EC has, so the governor's retry goes out
+        if (ret)
+            fan->level = old;
+    }
+    mutex_unlock(&ec_lock);
+
+    return ret;
+}
+
+static const struct thermal_cooling_device_ops ec_cooling_ops = {
+    .get_max_state = ec_cooling_get_max_state,
+    .get_cur_state = ec_cooling_get_cur_state,
+    .set_cur_state = ec_cooling_set_cur_state,
+};
+
+// The zone polls every thermal_poll_ms; a temperature change seen by the
+// worker in between updates it right away, so trip crossings are not held
+// back by the polling interval. Called without ec_lock, as the update reads
+// the temperature through ec_thermal_get_temp().
+static void ec_thermal_notify(void)
+{
+    static u8 last_temp;
+
+    u8 temp = READ_ONCE(ec_temp.temp);
+
+    if (!ec_thermal_zone || temp == last_temp)
+        return;
+
+    last_temp = temp;
+    thermal_zone_device_update(ec_thermal_zone, THERMAL_EVENT_TEMP_SAMPLE);
+}
+
+static void ec_thermal_unregister(void)
+{
+    int i;
+
+    ec_thermal_ready = false;
+    if (ec_thermal_zone) {
+        thermal_zone_device_unregister(ec_thermal_zone);
+        ec_thermal_zone = NULL;
+    }
+    for (i = 0; i < ARRAY_SIZE(ec_cooling_devs); i++) {
+        if (!IS_ERR_OR_NULL(ec_cooling_devs[i]))
+            thermal_cooling_device_unregister(ec_cooling_devs[i]);
+        ec_cooling_devs[i] = NULL;
+    }
+}
+
+// Not fatal: without the zone the driver works as before, only the thermal
+// fan mode is unavailable.
+static void ec_thermal_register(void)
+{
+    // both trips are writable through the thermal zone's sysfs
+    const struct thermal_trip trips[] = {
+        {
+            .type        = THERMAL_TRIP_ACTIVE,
+            .temperature = thermal_active_temp * 1000,
+            .hysteresis  = 5000,
+            .flags       = THERMAL_TRIP_FLAG_RW,
+        },
+        {
+            .type        = THERMAL_TRIP_PASSIVE,
+            .temperature = thermal_passive_temp * 1000,
+            .hysteresis  = 5000,
+            .flags       = THERMAL_TRIP_FLAG_RW,
+        },
+    };
+    char type[THERMAL_NAME_LENGTH];
+    int  ret;
+    int  i;
+
+    // cooling devices first, so the zone binds them when it registers
+    for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+        snprintf(type, sizeof(type), "su_axb35-%s", ec_fans[i].name);
+        ec_cooling_devs[i] =
+            thermal_cooling_device_register(type, &ec_fans[i], &ec_cooling_ops);
+        if (IS_ERR(ec_cooling_devs[i])) {
+            ret = PTR_ERR(ec_cooling_devs[i]);
+            goto fail;
+        }
+    }
+
+    ec_thermal_zone = thermal_zone_device_register_with_trips(
+        "su_axb35", trips, ARRAY_SIZE(trips), NULL, &ec_thermal_ops, NULL,
+        thermal_poll_ms, thermal_poll_ms);
+    if (IS_ERR(ec_thermal_zone)) {
+        ret             = PTR_ERR(ec_thermal_zone);
+        ec_thermal_zone = NULL;
+        goto fail;
+    }
+
+    ret = thermal_zone_device_enable(ec_thermal_zone);
+    if (ret)
+        goto fail;
+
+    ec_thermal_ready = true;
+    return;
+
+fail:
+    pr_warn("ec_su_axb35: Failed to register thermal zone (%d)\n", ret);
+    ec_thermal_unregister();
+}
+
+#else
+
+static void ec_thermal_notify(void)
+{
+}
+
+static void ec_thermal_register(void)
+{
+}
+
+static void ec_thermal_unregister(void)
+{
+}
+
+#endif
+
+static const struct hwmon_ops ec_hwmon_ops = {
+    .is_visible  = ec_hwmon_is_visible,
+    .read        = ec_hwmon_read,
+    .read_string = ec_hwmon_read_string,
+    .write       = ec_hwmon_write,
+};
+
+static const struct hwmon_channel_info *const ec_hwmon_info[] = {
+    HWMON_CHANNEL_INFO(temp, HWMON_T_INPUT | HWMON_T_LOWEST | HWMON_T_HIGHEST |
+                                 HWMON_T_RESET_HISTORY),
+    HWMON_CHANNEL_INFO(
+        fan, HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_TARGET | HWMON_F_FAULT,
+        HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_TARGET | HWMON_F_FAULT,
+        HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_TARGET | HWMON_F_FAULT),
+    HWMON_CHANNEL_INFO(pwm, HWMON_PWM_INPUT | HWMON_PWM_ENABLE,
+                       HWMON_PWM_INPUT | HWMON_PWM_ENABLE,
+                       HWMON_PWM_INPUT | HWMON_PWM_ENABLE),
+    NULL
+};
+
+static const struct hwmon_chip_info ec_hwmon_chip_info = {
+    .ops  = &ec_hwmon_ops,
+    .info = ec_hwmon_info,
+};
+
+// /dev/ec_su_axb35, the whole snapshot as one binary struct
+
+#define EC_STATE_MINOR   (ARRAY_SIZE(ec_fans) + 2)
+#define EC_HISTORY_MINOR (ARRAY_SIZE(ec_fans) + 3)
+#define EC_MINOR_COUNT   (ARRAY_SIZE(ec_fans) + 4)
+
+// Caller holds ec_lock.
+static void ec_state_fill(struct ec_su_axb35_state *st)
+{
+    int i;
+
+    BUILD_BUG_ON(ARRAY_SIZE(ec_fans) != EC_SU_AXB35_FANS);
+
+    memset(st, 0, sizeof(*st));
+    st->version      = EC_SU_AXB35_STATE_VERSION;
+    st->size         = sizeof(*st);
+    st->seq          = ec_snapshot_seq;
+    st->timestamp_ns = ec_snapshot_time;
+
+    for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+        struct ec_fan                *fan = &ec_fans[i];
+        struct ec_su_axb35_fan_state *fs  = &st->fan[i];
+        struct ec_fan_config          cfg;
+
+        fan_config_get(fan, &cfg);
+        fs->rpm   = fan->rpm;
+        fs->mode  = fan->mode; // enum fan_mode matches EC_SU_AXB35_FAN_*
+        fs->level = fan->level;
+        memcpy(fs->rampup_curve, &cfg.rampup_curve[1],
+               EC_SU_AXB35_CURVE_POINTS);
+        memcpy(fs->rampdown_curve, &cfg.rampdown_curve[1],
+               EC_SU_AXB35_CURVE_POINTS);
+    }
+
+    st->temp       = ec_temp.temp;
+    st->temp_min   = ec_temp.temp_min;
+    st->temp_max   = ec_temp.temp_max;
+    st->power_mode = ec_apu.power_mode;
+}
+
+// The live page mirrors the snapshot for mmap() readers. It is only written
+// under ec_lock, readers in userspace follow the protocol documented with
+// struct ec_su_axb35_live.
+static struct ec_su_axb35_live *ec_live;
+
+// Caller holds ec_lock.
+static void ec_live_publish(void)
+{
+    if (!ec_live)
+        return;
+
+    WRITE_ONCE(ec_live->seq, ec_live->seq + 1);
+    smp_wmb();
+    ec_state_fill(&ec_live->state);
+    smp_wmb();
+    WRITE_ONCE(ec_live->seq, ec_live->seq + 1);
+}
+
+static ssize_t ec_state_read(struct file *file, char __user *buf, size_t count,
+                             loff_t *ppos)
+{
+    struct ec_su_axb35_state st;
+    int                      ret;
+
+    mutex_lock(&ec_lock);
+    ret = ec_snapshot_update();
+    if (!ret)
+        ec_state_fill(&st);
+    mutex_unlock(&ec_lock);
+
+    if (ret)
+        return ret;
+
+    return simple_read_from_buffer(buf, count, ppos, &st, sizeof(st));
+}
+
+static int ec_state_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    if (!ec_live)
+        return -ENODEV;
+    if (vma->vm_pgoff || vma->vm_end - vma->vm_start > PAGE_SIZE)
+        return -EINVAL;
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    vm_flags_clear(vma, VM_MAYWRITE);
+#else
+    vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+
+    return vm_insert_page(vma, vma->vm_start, virt_to_page(ec_live));
+}
+
+static int ec_state_open(struct inode *inode, struct file *file)
+{
+    ec_consumer_get();
+    return 0;
+}
+
+static int ec_state_release(struct inode *inode, struct file *file)
+{
+    ec_consumer_put();
+    return 0;
+}
 
-    // TODO: handle error
-    ec_write(fan->mode_reg, val);
+static const struct file_operations ec_state_fops = {
+    .owner   = THIS_MODULE,
+    .open    = ec_state_open,
+    .release = ec_state_release,
+    .read    = ec_state_read,
+    .mmap   = ec_state_mmap,
+    .llseek = default_llseek,
+};
 
-    // When switching to CURVE mode, set initial fan level based on current temperature
-    // to prevent RPM burst from inappropriate starting level
-    if (fan->mode == CURVE) {
-        u8 temp;
-        // TODO: handle error
-        if (ec_read(ec_temp.reg, &temp) == 0) {
-            u8 initial_level = 0;
-            int i;
-            
-            // Find the appropriate level based on current temperature
-            // Use rampup curve for initial positioning to be more responsive
-            for (i = 5; i > 0; i--) {
-                if (temp >= fan->rampup_curve[i]) {
-                    initial_level = i;
-                    break;
-                }
-            }
-            
-            write_fan_level(fan, initial_level);
-        }
+static struct cdev    ec_state_cdev;
+static struct device *ec_state_dev;
+
+// /dev/ec_su_axb35_history, a ring of per-tick samples with a cursor per
+// open file, so collectors can drain it at their own pace
+
+static unsigned int history_len = 4096;
+module_param(history_len, uint, 0444);
+MODULE_PARM_DESC(history_len,
+                 "Number of per-tick samples kept for "
+                 "/dev/ec_su_axb35_history, rounded up to a power of two "
+                 "(default: 4096, 0 = disabled)");
+
+static struct ec_su_axb35_sample *ec_history;
+static u64                        ec_history_head; // seq of the next sample
+static DEFINE_MUTEX(ec_history_lock);
+static DECLARE_WAIT_QUEUE_HEAD(ec_history_wq);
+
+static struct cdev    ec_history_cdev;
+static struct device *ec_history_dev;
+
+struct ec_history_reader {
+    u64 cursor;
+    u64 overruns;
+};
+
+// Appends the current snapshot. Caller holds ec_lock.
+static void ec_history_append(const u8 *action)
+{
+    struct ec_su_axb35_sample *smp;
+    int                        i;
+
+    if (!ec_history)
+        return;
+
+    mutex_lock(&ec_history_lock);
+
+    smp = &ec_history[ec_history_head & (history_len - 1)];
+    memset(smp, 0, sizeof(*smp));
+    smp->seq          = ec_history_head;
+    smp->timestamp_ns = ec_snapshot_time;
+    for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+        smp->rpm[i]    = ec_fans[i].rpm;
+        smp->mode[i]   = ec_fans[i].mode;
+        smp->level[i]  = ec_fans[i].level;
+        smp->action[i] = action[i];
     }
+    smp->temp       = ec_temp.temp;
+    smp->power_mode = ec_apu.power_mode;
 
-    return count;
+    WRITE_ONCE(ec_history_head, ec_history_head + 1);
+
+    mutex_unlock(&ec_history_lock);
+
+    wake_up_interruptible(&ec_history_wq);
 }
 
-static struct device_attribute dev_attr_fan_mode =
-    __ATTR(mode, 0644, fan_mode_show, fan_mode_store);
+// Caller holds ec_history_lock.
+static u64 ec_history_oldest(void)
+{
+    return ec_history_head > history_len ? ec_history_head - history_len : 0;
+}
 
-static ssize_t fan_curve_show(u8 *curve, char *buf)
+// Moves a reader that fell more than a full ring behind to the oldest
+// sample still kept. Caller holds ec_history_lock.
+static void ec_history_catch_up(struct ec_history_reader *rd)
 {
-    int   i;
-    char *p = buf;
+    u64 oldest = ec_history_oldest();
 
-    for (i = 1; i < 6; i++) {
-        p += sprintf(p, "%d", curve[i]);
-        if (i < 5) {
-            *p++ = ',';
-        }
+    if (rd->cursor < oldest) {
+        rd->overruns += oldest - rd->cursor;
+        rd->cursor = oldest;
     }
-    *p++ = '\n';
-    *p   = '\0';
+}
 
-    return p - buf;
+static bool ec_history_readable(struct ec_history_reader *rd)
+{
+    return READ_ONCE(ec_history_head) != rd->cursor;
 }
 
-static ssize_t fan_curve_store(u8 *curve, const char *buf, size_t count)
+static int ec_history_open(struct inode *inode, struct file *file)
 {
-    char *str = kstrndup(buf, count, GFP_KERNEL);
-    char *token;
-    int   values[5];
-    int   i   = 0;
-    int   ret = 0;
+    struct ec_history_reader *rd;
 
-    if (!str)
+    if (!ec_history)
+        return -ENODEV;
+
+    rd = kzalloc(sizeof(*rd), GFP_KERNEL);
+    if (!rd)
         return -ENOMEM;
 
-    token = strsep(&str, ",");
-    while (token && i < 5) {
-        if (kstrtoint(token, 10, &values[i]) < 0) {
-            ret = -EINVAL;
-            break;
-        }
-        if (values[i] < 0 || values[i] > 100) {
-            ret = -EINVAL;
-            break;
-        }
-        i++;
-        token = strsep(&str, ",");
-    }
+    // start with the oldest sample still kept
+    mutex_lock(&ec_history_lock);
+    rd->cursor = ec_history_oldest();
+    mutex_unlock(&ec_history_lock);
 
-    if (i != 5)
-        ret = -EINVAL;
+    file->private_data = rd;
+    ec_consumer_get();
+    return nonseekable_open(inode, file);
+}
 
-    if (ret == 0) {
-        for (i = 0; i < 5; i++) {
-            curve[i + 1] = values[i];
-        }
+static int ec_history_release(struct inode *inode, struct file *file)
+{
+    ec_consumer_put();
+    kfree(file->private_data);
+    return 0;
+}
+
+static ssize_t ec_history_read(struct file *file, char __user *buf,
+                               size_t count, loff_t *ppos)
+{
+    struct ec_history_reader *rd = file->private_data;
+    struct ec_su_axb35_sample chunk[8];
+    size_t                    want = count / sizeof(chunk[0]);
+    size_t                    done = 0;
+    int                       ret;
+
+    if (want == 0)
+        return -EINVAL;
+
+    if (!ec_history_readable(rd)) {
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        ret = wait_event_interruptible(ec_history_wq, ec_history_readable(rd));
+        if (ret)
+            return ret;
     }
 
-    kfree(str);
-    return ret ? ret : count;
+    // copy out in small chunks so the worker never waits on a page fault
+    while (done < want) {
+        size_t n;
+        size_t i;
+
+        mutex_lock(&ec_history_lock);
+        ec_history_catch_up(rd);
+        n = min_t(size_t, ec_history_head - rd->cursor,
+                  min(want - done, ARRAY_SIZE(chunk)));
+        for (i = 0; i < n; i++)
+            chunk[i] = ec_history[(rd->cursor + i) & (history_len - 1)];
+        rd->cursor += n;
+        mutex_unlock(&ec_history_lock);
+
+        if (n == 0)
+            break;
+        if (copy_to_user(buf + done * sizeof(chunk[0]), chunk,
+                         n * sizeof(chunk[0])))
+            return -EFAULT;
+        done += n;
+    }
+
+    return done * sizeof(chunk[0]);
 }
 
-static ssize_t fan_rampup_curve_show(struct device           *dev,
-                                     struct device_attribute *attr, char *buf)
+static __poll_t ec_history_poll(struct file *file, poll_table *wait)
 {
-    struct ec_fan *fan = dev_get_drvdata(dev);
-    return fan_curve_show(fan->rampup_curve, buf);
+    struct ec_history_reader *rd = file->private_data;
+
+    poll_wait(file, &ec_history_wq, wait);
+
+    return ec_history_readable(rd) ? EPOLLIN | EPOLLRDNORM : 0;
 }
 
-static ssize_t fan_rampup_curve_store(struct device           *dev,
-                                      struct device_attribute *attr,
-                                      const char *buf, size_t count)
+static long ec_history_ioctl(struct file *file, unsigned int cmd,
+                             unsigned long arg)
 {
-    struct ec_fan *fan = dev_get_drvdata(dev);
-    return fan_curve_store(fan->rampup_curve, buf, count);
+    struct ec_history_reader       *rd   = file->private_data;
+    struct ec_su_axb35_history_info info = { 0 };
+
+    if (cmd != EC_SU_AXB35_IOC_HISTORY_INFO)
+        return -ENOTTY;
+
+    mutex_lock(&ec_history_lock);
+    ec_history_catch_up(rd);
+    info.head        = ec_history_head;
+    info.cursor      = rd->cursor;
+    info.overruns    = rd->overruns;
+    info.capacity    = history_len;
+    info.record_size = sizeof(struct ec_su_axb35_sample);
+    mutex_unlock(&ec_history_lock);
+
+    if (copy_to_user((void __user *)arg, &info, sizeof(info)))
+        return -EFAULT;
+    return 0;
 }
 
-static struct device_attribute dev_attr_fan_rampup_curve =
-    __ATTR(rampup_curve, 0644, fan_rampup_curve_show, fan_rampup_curve_store);
+static const struct file_operations ec_history_fops = {
+    .owner          = THIS_MODULE,
+    .open           = ec_history_open,
+    .release        = ec_history_release,
+    .read           = ec_history_read,
+    .poll           = ec_history_poll,
+    .unlocked_ioctl = ec_history_ioctl,
+    .compat_ioctl   = compat_ptr_ioctl,
+};
 
-static ssize_t fan_rampdown_curve_show(struct device           *dev,
-                                       struct device_attribute *attr, char *buf)
+static struct device *ec_chrdev_create(struct cdev                  *cdev,
+                                       const struct file_operations *fops,
+                                       unsigned int minor, const char *name)
 {
-    struct ec_fan *fan = dev_get_drvdata(dev);
-    return fan_curve_show(fan->rampdown_curve, buf);
+    struct device *dev;
+    int            ret;
+
+    cdev_init(cdev, fops);
+    cdev->owner = THIS_MODULE;
+    ret = cdev_add(cdev, MKDEV(MAJOR(ec_su_axb35_dev), minor), 1);
+    if (ret)
+        return ERR_PTR(ret);
+
+    dev = device_create(ec_class, NULL, MKDEV(MAJOR(ec_su_axb35_dev), minor),
+                        NULL, name);
+    if (IS_ERR(dev))
+        cdev_del(cdev);
+    return dev;
 }
 
-static ssize_t fan_rampdown_curve_store(struct device           *dev,
-                                        struct device_attribute *attr,
-                                        const char *buf, size_t count)
+static void ec_chrdev_destroy(struct cdev *cdev, struct device *dev,
+                              unsigned int minor)
 {
-    struct ec_fan *fan = dev_get_drvdata(dev);
-    return fan_curve_store(fan->rampdown_curve, buf, count);
+    if (IS_ERR(dev))
+        return;
+    device_destroy(ec_class, MKDEV(MAJOR(ec_su_axb35_dev), minor));
+    cdev_del(cdev);
 }
 
-static struct device_attribute dev_attr_fan_rampdown_curve = __ATTR(
-    rampdown_curve, 0644, fan_rampdown_curve_show, fan_rampdown_curve_store);
-
-static ssize_t temp_current_show(struct device           *dev,
-                                 struct device_attribute *attr, char *buf)
+// the binary nodes are meant for unprivileged collectors
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 2, 0)
+static char *ec_devnode(const struct device *dev, umode_t *mode)
+#else
+static char *ec_devnode(struct device *dev, umode_t *mode)
+#endif
 {
-    struct ec_temp *temp = dev_get_drvdata(dev);
-    u8              val;
-    // TODO: handle error
-    ec_read(temp->reg, &val);
-    return sprintf(buf, "%u\n", val);
+    if (mode && MINOR(dev->devt) >= EC_STATE_MINOR)
+        *mode = 0444;
+    return NULL;
 }
 
-static struct device_attribute dev_attr_temp_cur =
-    __ATTR(temp, 0444, temp_current_show, NULL);
-
-static ssize_t temp_min_show(struct device *dev, struct device_attribute *attr,
-                             char *buf)
+static bool ec_changed(int old, int new, unsigned int delta)
 {
-    struct ec_temp *temp = dev_get_drvdata(dev);
-    return sprintf(buf, "%u\n", temp->temp_min);
+    return old != new && abs(new - old) >= delta;
 }
 
-static struct device_attribute dev_attr_temp_min =
-    __ATTR(min, 0444, temp_min_show, NULL);
-
-static ssize_t temp_max_show(struct device *dev, struct device_attribute *attr,
-                             char *buf)
+// Wakes poll()/select() waiters on every attribute whose value changed
+// since its last notification. Caller holds ec_lock.
+static void ec_notify_changes(void)
 {
-    struct ec_temp *temp = dev_get_drvdata(dev);
-    return sprintf(buf, "%u\n", temp->temp_max);
-}
+    int i;
 
-static struct device_attribute dev_attr_temp_max =
-    __ATTR(max, 0444, temp_max_show, NULL);
+    for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+        struct ec_fan *fan = &ec_fans[i];
 
-static ssize_t apu_power_mode_show(struct device           *dev,
-                                   struct device_attribute *attr, char *buf)
+        if (IS_ERR_OR_NULL(fan->dev))
+            continue;
+
+        if (ec_changed(fan->notified_rpm, fan->rpm, notify_rpm_delta)) {
+            fan->notified_rpm = fan->rpm;
+            sysfs_notify(&fan->dev->kobj, NULL, "rpm");
+        }
+        if (fan->notified_level != fan->level) {
+            fan->notified_level = fan->level;
+            sysfs_notify(&fan->dev->kobj, NULL, "level");
+        }
+        if (fan->notified_mode != fan->mode) {
+            fan->notified_mode = fan->mode;
+            sysfs_notify(&fan->dev->kobj, NULL, "mode");
+        }
+    }
+
+    if (!IS_ERR_OR_NULL(ec_temp.dev)) {
+        if (ec_changed(ec_temp.notified_temp, ec_temp.temp,
+                       notify_temp_delta)) {
+            ec_temp.notified_temp = ec_temp.temp;
+            sysfs_notify(&ec_temp.dev->kobj, NULL, "temp");
+        }
+        if (ec_temp.notified_min != ec_temp.temp_min) {
+            ec_temp.notified_min = ec_temp.temp_min;
+            sysfs_notify(&ec_temp.dev->kobj, NULL, "min");
+        }
+        if (ec_temp.notified_max != ec_temp.temp_max) {
+            ec_temp.notified_max = ec_temp.temp_max;
+            sysfs_notify(&ec_temp.dev->kobj, NULL, "max");
+        }
+    }
+
+    if (!IS_ERR_OR_NULL(ec_apu.dev) &&
+        ec_apu.notified_power_mode != ec_apu.power_mode) {
+        ec_apu.notified_power_mode = ec_apu.power_mode;
+        sysfs_notify(&ec_apu.dev->kobj, NULL, "power_mode");
+    }
+}
+
+// Wakes every poller once, before the worker goes idle (see ec_poll_reader()).
+static void ec_notify_all(void)
 {
-    struct ec_apu *apu = dev_get_drvdata(dev);
-    u8             val;
-    // TODO: handle error
-    ec_read(apu->power_mode_reg, &val);
+    int i;
 
-    const char *mode = "unknown";
-    switch (val) {
-    case 0x00:
-        mode = "balanced";
-        break;
-    case 0x01:
-        mode = "performance";
-        break;
-    case 0x02:
-        mode = "quiet";
-        break;
-    default:
-        return -EINVAL;
+    for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+        struct ec_fan *fan = &ec_fans[i];
+
+        if (IS_ERR_OR_NULL(fan->dev))
+            continue;
+        sysfs_notify(&fan->dev->kobj, NULL, "rpm");
+        sysfs_notify(&fan->dev->kobj, NULL, "level");
+        sysfs_notify(&fan->dev->kobj, NULL, "mode");
     }
 
-    return sprintf(buf, "%s\n", mode);
+    if (!IS_ERR_OR_NULL(ec_temp.dev)) {
+        sysfs_notify(&ec_temp.dev->kobj, NULL, "temp");
+        sysfs_notify(&ec_temp.dev->kobj, NULL, "min");
+        sysfs_notify(&ec_temp.dev->kobj, NULL, "max");
+    }
+
+    if (!IS_ERR_OR_NULL(ec_apu.dev))
+        sysfs_notify(&ec_apu.dev->kobj, NULL, "power_mode");
 }
 
-static ssize_t apu_power_mode_store(struct device           *dev,
-                                    struct device_attribute *attr,
-                                    const char *buf, size_t count)
+// Picks the next worker interval. Caller holds ec_lock.
+static void ec_update_interval(bool ramping)
 {
-    struct ec_apu *apu = dev_get_drvdata(dev);
-    u8             val;
-    if (sysfs_streq(buf, "balanced")) {
-        val = 0x00;
-    } else if (sysfs_streq(buf, "performance")) {
-        val = 0x01;
-    } else if (sysfs_streq(buf, "quiet")) {
-        val = 0x02;
-    } else {
-        return -EINVAL;
+    static u64 last_ns;
+    static u8  last_temp;
+
+    unsigned int min_ms  = max(interval_min_ms, 50U);
+    unsigned int max_ms  = max(interval_max_ms, min_ms);
+    unsigned int dtemp   = abs((int)ec_temp.temp - last_temp);
+    u64          elapsed = div_u64(ec_snapshot_time - last_ns, NSEC_PER_MSEC);
+    bool         fast    = ramping;
+
+    // °C/s without dividing: dtemp / elapsed_s >= fast_temp_rate
+    if (last_ns && dtemp &&
+        (u64)dtemp * MSEC_PER_SEC >= (u64)fast_temp_rate * max(elapsed, 1ULL))
+        fast = true;
+
+    if (fast)
+        ec_interval_ms = min_ms;
+    else
+        ec_interval_ms = clamp(ec_interval_ms * 2, min_ms, max_ms);
+
+    last_ns   = ec_snapshot_time;
+    last_temp = ec_temp.temp;
+}
+
+static void ec_update_worker(struct work_struct *work)
+{
+    u8   action[ARRAY_SIZE(ec_fans)] = { 0 };
+    bool ramping                     = false;
+    u64  start                       = ktime_get_ns();
+    int  ret;
+    int  i;
+
+    WRITE_ONCE(ec_worker_idle, false);
+    mutex_lock(&ec_lock);
+
+    // one read of all registers per tick, shared with sysfs readers
+    ret = ec_snapshot_refresh();
+    if (ret)
+        goto out;
+
+    // update fan level if curve mode is active; the config is read under
+    // RCU, so rewriting curves never holds up the tick
+    rcu_read_lock();
+    for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+        struct ec_fan              *fan  = &ec_fans[i];
+        const struct ec_fan_config *cfg  = rcu_dereference(fan->config);
+        u8                          temp = ec_temp.temp;
+
+        if (fan->mode == CURVE) {
+            u8 level  = fan->level;
+            u8 target = fan_curve_target(fan, cfg, temp);
+
+            if (target != level) {
+                bool up = target > level;
+
+                write_fan_level(fan, target);
+
+                action[i] = up ? EC_SU_AXB35_ACTION_UP :
+                                 EC_SU_AXB35_ACTION_DOWN;
+                trace_ec_su_axb35_curve_level(
+                    i + 1, level, target, temp,
+                    up ? cfg->rampup_curve[target] :
+                         cfg->rampdown_curve[target + 1]);
+            }
+            ramping |= action[i] != EC_SU_AXB35_ACTION_NONE;
+        }
     }
+    rcu_read_unlock();
 
-    ec_write(apu->power_mode_reg, val);
-    return count;
+    // all level changes of this tick in one batch
+    ec_shadow_flush();
+
+    ec_update_interval(ramping);
+    trace_ec_su_axb35_tick(ec_temp.temp, ec_fans[0].level, ec_fans[1].level,
+                           ec_fans[2].level, ec_interval_ms);
+
+    ec_notify_changes();
+    ec_history_append(action);
+    ec_live_publish();
+
+out:
+    ec_stats_record(EC_OP_TICK, start, ret);
+    mutex_unlock(&ec_lock);
+
+    ec_thermal_notify();
+    ec_platform_profile_notify();
+
+    if (!ec_worker_ready)
+        return;
+
+    // Requeue the work
+    if (ec_worker_needed()) {
+        queue_delayed_work(system_power_efficient_wq, &ec_update_work,
+                           msecs_to_jiffies(ec_interval_ms));
+    } else {
+        // idle first, so a poller's re-read restarts the worker
+        WRITE_ONCE(ec_worker_idle, true);
+        ec_notify_all();
+    }
 }
 
-static struct device_attribute dev_attr_apu_power_mode =
-    __ATTR(power_mode, 0644, apu_power_mode_show, apu_power_mode_store);
+// System sleep. The firmware may come back from suspend with its own fan
+// settings, and FIXED cannot be told from CURVE on the EC, so the modes,
+// levels and power mode are saved on suspend and written back in one batch
+// on resume, followed by an immediate tick. Curves and controller settings
+// are driver memory and survive as they are. The same callbacks handle
+// hibernation (freeze/thaw, poweroff/restore).
+
+struct ec_pm_state {
+    enum fan_mode mode[ARRAY_SIZE(ec_fans)];
+    u8            level[ARRAY_SIZE(ec_fans)];
+    u8            power_mode;
+    bool          valid;
+    bool          worker_ready;
+};
 
-static struct delayed_work ec_update_work;
+static struct ec_pm_state ec_pm_saved;
 
-static void ec_update_worker(struct work_struct *work)
+static int __maybe_unused ec_suspend(struct device *dev)
 {
-    u8 temp;
-    // TODO: handle error
-    ec_read(ec_temp.reg, &temp);
     int i;
 
-    // Update min/max
-    if (ec_temp.temp_min == 0 || temp < ec_temp.temp_min)
-        ec_temp.temp_min = temp;
-
-    if (temp > ec_temp.temp_max)
-        ec_temp.temp_max = temp;
+    // stop the worker first, so no tick changes a level after the save
+    ec_pm_saved.worker_ready = ec_worker_ready;
+    ec_worker_ready          = false;
+    cancel_delayed_work_sync(&ec_update_work);
 
-    // update fan level if curve mode is active
+    mutex_lock(&ec_lock);
+    // if the refresh fails, the last known state is still worth restoring
+    ec_snapshot_update();
+    ec_pm_saved.valid = ec_snapshot_seq != 0;
     for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
-        struct ec_fan *fan = &ec_fans[i];
+        ec_pm_saved.mode[i]  = ec_fans[i].mode;
+        ec_pm_saved.level[i] = ec_fans[i].level;
+    }
+    ec_pm_saved.power_mode = ec_apu.power_mode;
+    mutex_unlock(&ec_lock);
 
-        if (fan->mode == CURVE) {
-            u8 level = read_fan_level(fan);
-            if (level < 5 && temp >= fan->rampup_curve[level + 1]) {
-                write_fan_level(fan, level + 1);
-            } else if (level > 0 && temp <= fan->rampdown_curve[level])
-                write_fan_level(fan, level - 1);
+    return 0;
+}
+
+static int __maybe_unused ec_resume(struct device *dev)
+{
+    u64 start = ktime_get_ns();
+    int ret   = 0;
+    int i;
+
+    mutex_lock(&ec_lock);
+    if (ec_pm_saved.valid) {
+        // the shadow is from before the suspend, write every register
+        bitmap_zero(ec_shadow_valid, 256);
+
+        for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+            struct ec_fan *fan  = &ec_fans[i];
+            enum fan_mode  mode = ec_pm_saved.mode[i];
+            u8             val;
+
+            if (fan_mode_reg_value(fan, mode, &val))
+                continue;
+            if (mode != AUTO)
+                write_fan_level(fan, ec_pm_saved.level[i]);
+            ec_shadow_set(fan->mode_reg, val);
+            fan->mode = mode;
         }
+        ec_shadow_set(ec_apu.power_mode_reg, ec_pm_saved.power_mode);
+
+        ret = ec_shadow_flush();
+        if (ret)
+            pr_warn("ec_su_axb35: Failed to restore fan settings on resume "
+                    "(%d)\n",
+                    ret);
     }
+    ec_snapshot_valid = false;
+    ec_interval_ms    = interval_min_ms;
+    ec_stats_record(EC_OP_RESUME, start, ret);
+    mutex_unlock(&ec_lock);
+
+    // thermal control is back with the first tick, not after an interval
+    ec_worker_ready = ec_pm_saved.worker_ready;
+    ec_worker_kick();
+    return 0;
+}
 
-    // Requeue the work
-    schedule_delayed_work(&ec_update_work,
-                          msecs_to_jiffies(1000)); // every 1 sec
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
+static DEFINE_SIMPLE_DEV_PM_OPS(ec_pm_ops, ec_suspend, ec_resume);
+#else
+static SIMPLE_DEV_PM_OPS(ec_pm_ops, ec_suspend, ec_resume);
+#endif
+
+// binds to ec_pdev only to get the PM callbacks
+static struct platform_driver ec_pdriver = {
+    .driver = {
+        .name = "ec_su_axb35",
+        .pm   = &ec_pm_ops,
+    },
+};
+
+// Frees the current configs; earlier ones are already queued by kfree_rcu().
+static void ec_fan_config_free(void)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+        kfree(rcu_dereference_protected(ec_fans[i].config, true));
+        RCU_INIT_POINTER(ec_fans[i].config, NULL);
+    }
 }
 
-static dev_t         ec_su_axb35_dev;
-static struct class *ec_class;
+static struct class           *ec_class;
+static struct platform_device *ec_pdev;
+static struct device          *ec_hwmon_dev;
 
 static int __init ec_su_axb35_init(void)
 {
     int i;
     int ret;
 
-    ret = alloc_chrdev_region(&ec_su_axb35_dev, 0, ARRAY_SIZE(ec_fans) + 2,
+    if (sysfs_streq(backend, "sim")) {
+        ec_sim_reset();
+        ec_backend = &ec_sim_backend;
+    } else if (!sysfs_streq(backend, "acpi")) {
+        pr_err("ec_su_axb35: Unknown backend '%s'\n", backend);
+        return -EINVAL;
+    }
+
+    for (i = 0; i < stats_windows_count; i++)
+        stats_windows[i] = clamp(stats_windows[i], 1U, 86400U);
+
+    for (i = 0; i < ARRAY_SIZE(ec_fans); i++)
+        ec_fans[i].rpm_filter = min(rpm_filter, (unsigned int)EC_RPM_FILTER_MAX);
+
+    for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
+        struct ec_fan_config *cfg = kmemdup(
+            &ec_fans[i].defaults, sizeof(*cfg), GFP_KERNEL);
+
+        if (!cfg) {
+            ec_fan_config_free();
+            return -ENOMEM;
+        }
+        RCU_INIT_POINTER(ec_fans[i].config, cfg);
+    }
+
+    ret = alloc_chrdev_region(&ec_su_axb35_dev, 0, EC_MINOR_COUNT,
                               "ec_su_axb35");
     if (ret < 0) {
         pr_err("ec_su_axb35: Failed to allocation major number\n");
+        ec_fan_config_free();
         return ret;
     }
 
@@ -546,9 +3617,33 @@ static int __init ec_su_axb35_init(void)
 #endif
 
     if (IS_ERR(ec_class)) {
-        unregister_chrdev_region(ec_su_axb35_dev, ARRAY_SIZE(ec_fans) + 2);
+        unregister_chrdev_region(ec_su_axb35_dev, EC_MINOR_COUNT);
+        ec_fan_config_free();
         return PTR_ERR(ec_class);
     }
+    ec_class->devnode = ec_devnode;
+
+    // the PM callbacks may run as soon as the device is bound
+    INIT_DEFERRABLE_WORK(&ec_update_work, ec_update_worker);
+
+    ret = platform_driver_register(&ec_pdriver);
+    if (ret) {
+        class_destroy(ec_class);
+        unregister_chrdev_region(ec_su_axb35_dev, EC_MINOR_COUNT);
+        ec_fan_config_free();
+        return ret;
+    }
+
+    // parent for the hwmon device
+    ec_pdev = platform_device_register_simple("ec_su_axb35",
+                                              PLATFORM_DEVID_NONE, NULL, 0);
+    if (IS_ERR(ec_pdev)) {
+        platform_driver_unregister(&ec_pdriver);
+        class_destroy(ec_class);
+        unregister_chrdev_region(ec_su_axb35_dev, EC_MINOR_COUNT);
+        ec_fan_config_free();
+        return PTR_ERR(ec_pdev);
+    }
 
     for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
         struct ec_fan *fan = &ec_fans[i];
@@ -560,11 +3655,17 @@ static int __init ec_su_axb35_init(void)
 
         dev_set_drvdata(fan->dev, fan);
         device_create_file(fan->dev, &dev_attr_fan_rpm);
+        device_create_file(fan->dev, &dev_attr_fan_rpm_raw);
+        device_create_file(fan->dev, &dev_attr_fan_rpm_filter);
         device_create_file(fan->dev, &dev_attr_fan_mode);
         device_create_file(fan->dev, &dev_attr_fan_level);
         device_create_file(fan->dev, &dev_attr_fan_rampup_curve);
         device_create_file(fan->dev, &dev_attr_fan_rampdown_curve);
-        update_fan_mode(fan);
+        device_create_file(fan->dev, &dev_attr_fan_controller);
+        device_create_file(fan->dev, &dev_attr_fan_max_step_up);
+        device_create_file(fan->dev, &dev_attr_fan_max_step_down);
+        if (sysfs_create_group(&fan->dev->kobj, &ec_series_group))
+            pr_warn("ec_su_axb35: Failed to add %s stats\n", fan->name);
     }
 
     ec_temp.dev = device_create(
@@ -575,6 +3676,8 @@ static int __init ec_su_axb35_init(void)
         device_create_file(ec_temp.dev, &dev_attr_temp_cur);
         device_create_file(ec_temp.dev, &dev_attr_temp_min);
         device_create_file(ec_temp.dev, &dev_attr_temp_max);
+        if (sysfs_create_group(&ec_temp.dev->kobj, &ec_series_group))
+            pr_warn("ec_su_axb35: Failed to add %s stats\n", ec_temp.name);
     }
 
     ec_apu.dev = device_create(
@@ -583,25 +3686,92 @@ static int __init ec_su_axb35_init(void)
     if (!IS_ERR(ec_apu.dev)) {
         dev_set_drvdata(ec_apu.dev, &ec_apu);
         device_create_file(ec_apu.dev, &dev_attr_apu_power_mode);
+        device_create_file(ec_apu.dev, &dev_attr_apu_profile);
+        device_create_file(ec_apu.dev, &dev_attr_apu_profiles);
+    }
+
+    BUILD_BUG_ON(sizeof(struct ec_su_axb35_live) > PAGE_SIZE);
+    ec_live = (struct ec_su_axb35_live *)get_zeroed_page(GFP_KERNEL);
+    if (!ec_live)
+        pr_warn("ec_su_axb35: Failed to allocate live state page\n");
+
+    ec_state_dev = ec_chrdev_create(&ec_state_cdev, &ec_state_fops,
+                                    EC_STATE_MINOR, "ec_su_axb35");
+    if (IS_ERR(ec_state_dev))
+        pr_warn("ec_su_axb35: Failed to add state device\n");
+
+    if (history_len) {
+        history_len = roundup_pow_of_two(min(history_len, 1U << 20));
+        ec_history  = kvcalloc(history_len, sizeof(*ec_history), GFP_KERNEL);
+    }
+    if (ec_history) {
+        ec_history_dev = ec_chrdev_create(&ec_history_cdev, &ec_history_fops,
+                                          EC_HISTORY_MINOR,
+                                          "ec_su_axb35_history");
+        if (IS_ERR(ec_history_dev))
+            pr_warn("ec_su_axb35: Failed to add history device\n");
+    } else {
+        ec_history_dev = ERR_PTR(-ENODEV);
     }
 
-    INIT_DELAYED_WORK(&ec_update_work, ec_update_worker);
-    schedule_delayed_work(&ec_update_work, msecs_to_jiffies(1000));
+    // prime the snapshot so the initial fan modes are known
+    mutex_lock(&ec_lock);
+    if (ec_snapshot_refresh() == 0) {
+        ec_notify_changes();
+        ec_live_publish();
+    }
+    mutex_unlock(&ec_lock);
+
+    ec_hwmon_dev = hwmon_device_register_with_info(
+        &ec_pdev->dev, "su_axb35", NULL, &ec_hwmon_chip_info,
+        ec_hwmon_auto_point_groups);
+    if (IS_ERR(ec_hwmon_dev))
+        pr_warn("ec_su_axb35: Failed to register hwmon device\n");
+
+    ec_thermal_register();
+    ec_platform_profile_register(&ec_pdev->dev);
+
+    ec_debugfs = debugfs_create_dir("ec_su_axb35", NULL);
+    debugfs_create_file("ec_stats", 0444, ec_debugfs, NULL, &ec_stats_fops);
+    debugfs_create_file("reset", 0200, ec_debugfs, NULL,
+                        &ec_stats_reset_fops);
 
-    pr_info("ec_su_axb35: Sixunited AXB35-02 EC driver loaded\n");
+    ec_interval_ms  = interval_min_ms;
+    ec_poll_lease   = jiffies;
+    ec_worker_ready = true;
+    ec_worker_kick();
+
+    pr_info("ec_su_axb35: Sixunited AXB35-02 EC driver loaded (%s backend)\n",
+            ec_backend->name);
     return 0;
 }
 
 static void __exit ec_su_axb35_exit(void)
 {
     int i;
+
+    // the worker notifies the class devices, stop it before they go away
+    ec_worker_ready = false;
+    cancel_delayed_work_sync(&ec_update_work);
+
+    debugfs_remove_recursive(ec_debugfs);
+
+    if (!IS_ERR(ec_hwmon_dev))
+        hwmon_device_unregister(ec_hwmon_dev);
+
     for (i = 0; i < ARRAY_SIZE(ec_fans); i++) {
         if (!IS_ERR(ec_fans[i].dev)) {
             device_remove_file(ec_fans[i].dev, &dev_attr_fan_rpm);
+            device_remove_file(ec_fans[i].dev, &dev_attr_fan_rpm_raw);
+            device_remove_file(ec_fans[i].dev, &dev_attr_fan_rpm_filter);
             device_remove_file(ec_fans[i].dev, &dev_attr_fan_mode);
             device_remove_file(ec_fans[i].dev, &dev_attr_fan_level);
             device_remove_file(ec_fans[i].dev, &dev_attr_fan_rampup_curve);
             device_remove_file(ec_fans[i].dev, &dev_attr_fan_rampdown_curve);
+            device_remove_file(ec_fans[i].dev, &dev_attr_fan_controller);
+            device_remove_file(ec_fans[i].dev, &dev_attr_fan_max_step_up);
+            device_remove_file(ec_fans[i].dev, &dev_attr_fan_max_step_down);
+            sysfs_remove_group(&ec_fans[i].dev->kobj, &ec_series_group);
             device_destroy(ec_class, MKDEV(MAJOR(ec_su_axb35_dev), i));
         }
     }
@@ -610,20 +3780,34 @@ static void __exit ec_su_axb35_exit(void)
         device_remove_file(ec_temp.dev, &dev_attr_temp_cur);
         device_remove_file(ec_temp.dev, &dev_attr_temp_min);
         device_remove_file(ec_temp.dev, &dev_attr_temp_max);
+        sysfs_remove_group(&ec_temp.dev->kobj, &ec_series_group);
         device_destroy(ec_class,
                        MKDEV(MAJOR(ec_su_axb35_dev), ARRAY_SIZE(ec_fans)));
     }
 
     if (!IS_ERR(ec_apu.dev)) {
         device_remove_file(ec_apu.dev, &dev_attr_apu_power_mode);
+        device_remove_file(ec_apu.dev, &dev_attr_apu_profile);
+        device_remove_file(ec_apu.dev, &dev_attr_apu_profiles);
         device_destroy(ec_class,
                        MKDEV(MAJOR(ec_su_axb35_dev), ARRAY_SIZE(ec_fans) + 1));
     }
 
-    cancel_delayed_work_sync(&ec_update_work);
+    ec_chrdev_destroy(&ec_history_cdev, ec_history_dev, EC_HISTORY_MINOR);
+    ec_chrdev_destroy(&ec_state_cdev, ec_state_dev, EC_STATE_MINOR);
+
+    // after the worker and apu/power_mode and apu/profile are gone, so
+    // nothing calls ec_platform_profile_notify() on the removed device
+    ec_platform_profile_unregister();
+    ec_thermal_unregister();
+    kvfree(ec_history);
+    free_page((unsigned long)ec_live);
+    ec_fan_config_free();
 
+    platform_device_unregister(ec_pdev);
+    platform_driver_unregister(&ec_pdriver);
     class_destroy(ec_class);
-    unregister_chrdev_region(ec_su_axb35_dev, ARRAY_SIZE(ec_fans) + 2);
+    unregister_chrdev_region(ec_su_axb35_dev, EC_MINOR_COUNT);
     pr_info("ec_su_axb35: Module unloaded\n");
 }
 
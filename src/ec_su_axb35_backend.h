@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+// ec_su_axb35_backend.h - EC access backends
+
+#ifndef _EC_SU_AXB35_BACKEND_H
+#define _EC_SU_AXB35_BACKEND_H
+
+#include <linux/types.h>
+
+// All calls are serialized by the driver's EC lock.
+struct ec_backend {
+    const char *name;
+    int (*read)(u8 reg, u8 *val);
+    int (*write)(u8 reg, u8 val);
+};
+
+// ec_su_axb35_sim.c
+extern const struct ec_backend ec_sim_backend;
+void                           ec_sim_reset(void);
+
+#endif // _EC_SU_AXB35_BACKEND_H
@@ -0,0 +1,184 @@
+// ec_su_axb35_sim.c - simulated AXB35 EC for testing without the board
+//
+// Models the register map used by the driver: mode registers 0x21/0x23/0x25,
+// level registers 0x22/0x24/0x26, fan speed at 0x35/0x36, 0x37/0x38 and
+// 0x28/0x29, temperature at 0x70 and the APU power mode at 0x31. Fans spin
+// up and down with some inertia towards the rpm of their level, and the
+// temperature follows a first order thermal model heated by the APU (scaled
+// by sim_load and the power mode) and cooled by the fans. In auto mode the
+// simulated firmware picks fan levels from the temperature itself.
+
+#include <linux/delay.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+
+#include "ec_su_axb35_backend.h"
+
+static unsigned int sim_latency_us = 0;
+module_param(sim_latency_us, uint, 0644);
+MODULE_PARM_DESC(sim_latency_us,
+                 "Simulated EC: delay per transaction in us (default: 0)");
+
+static unsigned int sim_load = 50;
+module_param(sim_load, uint, 0644);
+MODULE_PARM_DESC(sim_load, "Simulated EC: APU load in percent (default: 50)");
+
+static unsigned int sim_ambient = 25;
+module_param(sim_ambient, uint, 0644);
+MODULE_PARM_DESC(sim_ambient,
+                 "Simulated EC: ambient temperature in °C (default: 25)");
+
+#define SIM_TEMP_REG  0x70
+#define SIM_POWER_REG 0x31
+
+#define SIM_STEP_MS     100   // integration step
+#define SIM_MAX_DT_MS   60000 // longer gaps are close to steady state anyway
+#define SIM_FAN_TAU_MS  1500  // fan inertia
+#define SIM_HEAT_CAP    30    // J/K
+#define SIM_IDLE_MW     10000 // APU power at 0% load
+#define SIM_COND_MW     1700  // mW/K without airflow
+#define SIM_COND_RPM_MW 75    // mW/K per 1000 rpm of airflow
+
+struct sim_fan {
+    u8  mode_reg;
+    u8  speed_reg_high;
+    u16 max_rpm;
+    s32 rpm;
+};
+
+static struct sim_fan sim_fans[] = {
+    { .mode_reg = 0x21, .speed_reg_high = 0x35, .max_rpm = 5000 },
+    { .mode_reg = 0x23, .speed_reg_high = 0x37, .max_rpm = 5000 },
+    { .mode_reg = 0x25, .speed_reg_high = 0x28, .max_rpm = 3500 },
+};
+
+// APU power at 100% load per power mode register value
+static const u32 sim_power_mw[] = {
+    [0x00] = 85000,  // balanced
+    [0x01] = 120000, // performance
+    [0x02] = 55000,  // quiet
+};
+
+static u8  sim_regs[256];
+static s64 sim_temp_mc; // m°C
+static u64 sim_last_ns;
+
+// level register low nibble: 0x7 is off, 0x2-0x6 are 20%-100%
+static int sim_level(u8 val)
+{
+    val &= 0xF;
+    return val >= 0x2 && val <= 0x6 ? val - 1 : 0;
+}
+
+static void sim_step(unsigned int dt_ms)
+{
+    s64 temp_c   = div_s64(sim_temp_mc, 1000);
+    u32 airflow  = 0;
+    u32 power_mw = SIM_IDLE_MW;
+    s64 cond_mw;
+    s64 net_mw;
+    int i;
+
+    if (sim_regs[SIM_POWER_REG] < ARRAY_SIZE(sim_power_mw))
+        power_mw += div_u64((u64)sim_power_mw[sim_regs[SIM_POWER_REG]] *
+                                min(sim_load, 100U),
+                            100);
+
+    for (i = 0; i < ARRAY_SIZE(sim_fans); i++) {
+        struct sim_fan *fan   = &sim_fans[i];
+        u8             *level = &sim_regs[fan->mode_reg + 1];
+        s32             target;
+
+        // auto mode: the firmware drives the level from the temperature
+        if ((sim_regs[fan->mode_reg] & 0xF) == 0) {
+            int lvl = clamp_t(int, (temp_c - 45) / 10, 0, 5);
+
+            *level = (*level & 0xF0) | (lvl ? lvl + 1 : 0x7);
+        }
+
+        target = fan->max_rpm * sim_level(*level) / 5;
+        fan->rpm += (target - fan->rpm) * (s32)dt_ms / SIM_FAN_TAU_MS;
+        if (abs(target - fan->rpm) < 20)
+            fan->rpm = target;
+
+        sim_regs[fan->speed_reg_high]     = fan->rpm >> 8;
+        sim_regs[fan->speed_reg_high + 1] = fan->rpm & 0xFF;
+        airflow += fan->rpm;
+    }
+
+    cond_mw = SIM_COND_MW + div_u64((u64)airflow * SIM_COND_RPM_MW, 1000);
+    net_mw  = power_mw - div_s64(cond_mw * (sim_temp_mc -
+                                            (s64)sim_ambient * 1000),
+                                 1000);
+    // dT [mK] = P [mW] * dt [ms] / (C [J/K] * 1000)
+    sim_temp_mc += div_s64(net_mw * dt_ms, SIM_HEAT_CAP * 1000);
+
+    sim_regs[SIM_TEMP_REG] = clamp_t(s64, div_s64(sim_temp_mc, 1000), 0, 255);
+}
+
+static void sim_advance(void)
+{
+    u64          now = ktime_get_ns();
+    unsigned int dt_ms;
+
+    dt_ms       = min_t(u64, div_u64(now - sim_last_ns, NSEC_PER_MSEC),
+                        SIM_MAX_DT_MS);
+    sim_last_ns += (u64)dt_ms * NSEC_PER_MSEC;
+
+    while (dt_ms) {
+        unsigned int step = min(dt_ms, (unsigned int)SIM_STEP_MS);
+
+        sim_step(step);
+        dt_ms -= step;
+    }
+    if (now - sim_last_ns > (u64)SIM_MAX_DT_MS * NSEC_PER_MSEC)
+        sim_last_ns = now;
+}
+
+static void sim_delay(void)
+{
+    if (sim_latency_us)
+        fsleep(sim_latency_us);
+}
+
+static int sim_read(u8 reg, u8 *val)
+{
+    sim_delay();
+    sim_advance();
+    *val = sim_regs[reg];
+    return 0;
+}
+
+static int sim_write(u8 reg, u8 val)
+{
+    sim_delay();
+    sim_advance();
+    sim_regs[reg] = val;
+    return 0;
+}
+
+void ec_sim_reset(void)
+{
+    int i;
+
+    memset(sim_regs, 0, sizeof(sim_regs));
+    for (i = 0; i < ARRAY_SIZE(sim_fans); i++) {
+        u8 fan_bits = (i + 1) << 4;
+
+        sim_fans[i].rpm                    = 0;
+        sim_regs[sim_fans[i].mode_reg]     = fan_bits;       // auto
+        sim_regs[sim_fans[i].mode_reg + 1] = fan_bits | 0x7; // off
+    }
+    sim_regs[SIM_POWER_REG] = 0x00; // balanced
+    sim_temp_mc             = (s64)sim_ambient * 1000 + 15000;
+    sim_regs[SIM_TEMP_REG]  = div_s64(sim_temp_mc, 1000);
+    sim_last_ns             = ktime_get_ns();
+}
+
+const struct ec_backend ec_sim_backend = {
+    .name  = "sim",
+    .read  = sim_read,
+    .write = sim_write,
+};
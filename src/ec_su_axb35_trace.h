@@ -0,0 +1,158 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+// ec_su_axb35_trace.h - tracepoints for EC access and the curve controller
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM ec_su_axb35
+
+#if !defined(_EC_SU_AXB35_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _EC_SU_AXB35_TRACE_H
+
+#include <linux/tracepoint.h>
+
+#define show_fan_mode(mode)                                      \
+    __print_symbolic(mode, { 0, "auto" }, { 1, "fixed" }, { 2, "curve" }, \
+                     { 3, "thermal" })
+
+#define show_power_mode(mode)                                           \
+    __print_symbolic(mode, { 0x00, "balanced" }, { 0x01, "performance" }, \
+                     { 0x02, "quiet" })
+
+DECLARE_EVENT_CLASS(ec_su_axb35_ec_access,
+
+    TP_PROTO(u8 reg, u8 val, int ret, u64 duration_ns),
+
+    TP_ARGS(reg, val, ret, duration_ns),
+
+    TP_STRUCT__entry(
+        __field(u8, reg)
+        __field(u8, val)
+        __field(int, ret)
+        __field(u64, duration_ns)
+    ),
+
+    TP_fast_assign(
+        __entry->reg         = reg;
+        __entry->val         = val;
+        __entry->ret         = ret;
+        __entry->duration_ns = duration_ns;
+    ),
+
+    TP_printk("reg=0x%02x val=0x%02x ret=%d duration_ns=%llu", __entry->reg,
+              __entry->val, __entry->ret, __entry->duration_ns)
+);
+
+DEFINE_EVENT(ec_su_axb35_ec_access, ec_su_axb35_ec_read,
+    TP_PROTO(u8 reg, u8 val, int ret, u64 duration_ns),
+    TP_ARGS(reg, val, ret, duration_ns)
+);
+
+DEFINE_EVENT(ec_su_axb35_ec_access, ec_su_axb35_ec_write,
+    TP_PROTO(u8 reg, u8 val, int ret, u64 duration_ns),
+    TP_ARGS(reg, val, ret, duration_ns)
+);
+
+TRACE_EVENT(ec_su_axb35_tick,
+
+    TP_PROTO(u8 temp, u8 level1, u8 level2, u8 level3,
+             unsigned int interval_ms),
+
+    TP_ARGS(temp, level1, level2, level3, interval_ms),
+
+    TP_STRUCT__entry(
+        __field(u8, temp)
+        __field(u8, level1)
+        __field(u8, level2)
+        __field(u8, level3)
+        __field(unsigned int, interval_ms)
+    ),
+
+    TP_fast_assign(
+        __entry->temp        = temp;
+        __entry->level1      = level1;
+        __entry->level2      = level2;
+        __entry->level3      = level3;
+        __entry->interval_ms = interval_ms;
+    ),
+
+    TP_printk("temp=%u level=%u,%u,%u next_ms=%u", __entry->temp,
+              __entry->level1, __entry->level2, __entry->level3,
+              __entry->interval_ms)
+);
+
+TRACE_EVENT(ec_su_axb35_curve_level,
+
+    TP_PROTO(int fan, u8 old_level, u8 new_level, u8 temp, u8 threshold),
+
+    TP_ARGS(fan, old_level, new_level, temp, threshold),
+
+    TP_STRUCT__entry(
+        __field(int, fan)
+        __field(u8, old_level)
+        __field(u8, new_level)
+        __field(u8, temp)
+        __field(u8, threshold)
+    ),
+
+    TP_fast_assign(
+        __entry->fan       = fan;
+        __entry->old_level = old_level;
+        __entry->new_level = new_level;
+        __entry->temp      = temp;
+        __entry->threshold = threshold;
+    ),
+
+    TP_printk("fan%d level=%u->%u temp=%u threshold=%u", __entry->fan,
+              __entry->old_level, __entry->new_level, __entry->temp,
+              __entry->threshold)
+);
+
+TRACE_EVENT(ec_su_axb35_fan_mode,
+
+    TP_PROTO(int fan, int old_mode, int new_mode),
+
+    TP_ARGS(fan, old_mode, new_mode),
+
+    TP_STRUCT__entry(
+        __field(int, fan)
+        __field(int, old_mode)
+        __field(int, new_mode)
+    ),
+
+    TP_fast_assign(
+        __entry->fan      = fan;
+        __entry->old_mode = old_mode;
+        __entry->new_mode = new_mode;
+    ),
+
+    TP_printk("fan%d mode=%s->%s", __entry->fan,
+              show_fan_mode(__entry->old_mode),
+              show_fan_mode(__entry->new_mode))
+);
+
+TRACE_EVENT(ec_su_axb35_power_mode,
+
+    TP_PROTO(u8 old_mode, u8 new_mode),
+
+    TP_ARGS(old_mode, new_mode),
+
+    TP_STRUCT__entry(
+        __field(u8, old_mode)
+        __field(u8, new_mode)
+    ),
+
+    TP_fast_assign(
+        __entry->old_mode = old_mode;
+        __entry->new_mode = new_mode;
+    ),
+
+    TP_printk("power_mode=%s->%s", show_power_mode(__entry->old_mode),
+              show_power_mode(__entry->new_mode))
+);
+
+#endif // _EC_SU_AXB35_TRACE_H
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE ec_su_axb35_trace
+#include <trace/define_trace.h>
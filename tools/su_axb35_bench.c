@@ -0,0 +1,456 @@
+// su_axb35_bench.c - concurrent sysfs load and latency benchmark
+//
+// Runs reader threads over a set of ec_su_axb35 attributes, optionally with
+// writer threads, and reports throughput, latency percentiles, EC
+// transactions per logical read (from debugfs) and worker tick jitter (from
+// the history device). Works against the real board or backend=sim.
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ec_su_axb35.h"
+
+#define MAX_ATTRS   32
+#define MAX_SAMPLES (4 * 1024 * 1024) // latencies kept per thread
+
+struct attr_set {
+    const char *name;
+    const char *files[EC_SU_AXB35_FANS * 2];
+};
+
+// attribute sets selectable with -a and -W
+static const struct attr_set attr_sets[] = {
+    { "rpm", { "fan1/rpm", "fan2/rpm", "fan3/rpm" } },
+    { "mode", { "fan1/mode", "fan2/mode", "fan3/mode" } },
+    { "level", { "fan1/level", "fan2/level", "fan3/level" } },
+    { "curves",
+      { "fan1/rampup_curve", "fan2/rampup_curve", "fan3/rampup_curve",
+        "fan1/rampdown_curve", "fan2/rampdown_curve",
+        "fan3/rampdown_curve" } },
+    { "temp", { "temp1/temp", "temp1/min", "temp1/max" } },
+    { "power_mode", { "apu/power_mode" } },
+};
+
+struct attr_list {
+    char *path[MAX_ATTRS];
+    int   count;
+};
+
+struct thread_stats {
+    pthread_t thread;
+    uint64_t  ops;
+    uint64_t  errors;
+    uint32_t *lat_us;
+    size_t    samples;
+};
+
+static const char   *class_path = "/sys/class/ec_su_axb35";
+static const char   *stats_path = "/sys/kernel/debug/ec_su_axb35/ec_stats";
+static struct attr_list read_attrs;
+static struct attr_list write_attrs;
+static bool          keep_open;
+static atomic_bool   running = true;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int parse_attr_sets(const char *arg, struct attr_list *list)
+{
+    char *copy = strdup(arg);
+    char *save = NULL;
+    char *tok;
+
+    for (tok = strtok_r(copy, ",", &save); tok;
+         tok = strtok_r(NULL, ",", &save)) {
+        size_t i;
+        size_t j;
+
+        for (i = 0; i < sizeof(attr_sets) / sizeof(attr_sets[0]); i++) {
+            if (strcmp(tok, attr_sets[i].name) == 0)
+                break;
+        }
+        if (i == sizeof(attr_sets) / sizeof(attr_sets[0])) {
+            fprintf(stderr, "Unknown attribute set: %s\n", tok);
+            free(copy);
+            return -1;
+        }
+
+        for (j = 0; j < sizeof(attr_sets[i].files) / sizeof(char *) &&
+                    attr_sets[i].files[j] && list->count < MAX_ATTRS;
+             j++) {
+            char *path;
+
+            if (asprintf(&path, "%s/%s", class_path, attr_sets[i].files[j]) <
+                0)
+                exit(1);
+            list->path[list->count++] = path;
+        }
+    }
+
+    free(copy);
+    return 0;
+}
+
+static void record(struct thread_stats *st, uint64_t start, bool ok)
+{
+    st->ops++;
+    if (!ok)
+        st->errors++;
+    if (st->samples < MAX_SAMPLES)
+        st->lat_us[st->samples++] = (now_ns() - start) / 1000;
+}
+
+static void *reader(void *arg)
+{
+    struct thread_stats *st = arg;
+    int                  fds[MAX_ATTRS];
+    char                 buf[128];
+    int                  i;
+
+    for (i = 0; i < read_attrs.count; i++)
+        fds[i] = keep_open ? open(read_attrs.path[i], O_RDONLY) : -1;
+
+    while (running) {
+        for (i = 0; i < read_attrs.count && running; i++) {
+            uint64_t start = now_ns();
+            ssize_t  n;
+
+            // one logical read, the way a collector would do it
+            if (keep_open) {
+                n = pread(fds[i], buf, sizeof(buf), 0);
+            } else {
+                int fd = open(read_attrs.path[i], O_RDONLY);
+
+                n = fd < 0 ? -1 : read(fd, buf, sizeof(buf));
+                if (fd >= 0)
+                    close(fd);
+            }
+            record(st, start, n > 0);
+        }
+    }
+
+    for (i = 0; i < read_attrs.count; i++) {
+        if (fds[i] >= 0)
+            close(fds[i]);
+    }
+    return NULL;
+}
+
+// Writes back the current value, which exercises the store path and the
+// EC. It is not free of side effects: every write-back clears the active
+// profile, a level write-back races the curve controller, and writing
+// "curve" back to a mode re-positions the level from the rampup curve.
+static void *writer(void *arg)
+{
+    struct thread_stats *st = arg;
+    char                 buf[128];
+    int                  i;
+
+    while (running) {
+        for (i = 0; i < write_attrs.count && running; i++) {
+            uint64_t start = now_ns();
+            ssize_t  n     = -1;
+            int      fd    = open(write_attrs.path[i], O_RDWR);
+
+            if (fd >= 0) {
+                n = pread(fd, buf, sizeof(buf), 0);
+                if (n > 0)
+                    n = pwrite(fd, buf, n, 0);
+                close(fd);
+            }
+            record(st, start, n > 0);
+        }
+    }
+    return NULL;
+}
+
+// total EC reads + writes from debugfs, -1 if not available
+static long long ec_transactions(void)
+{
+    FILE     *f = fopen(stats_path, "r");
+    char      line[256];
+    long long total = 0;
+    int       found = 0;
+
+    if (!f)
+        return -1;
+
+    while (fgets(line, sizeof(line), f)) {
+        char      op[16];
+        long long count;
+
+        if (sscanf(line, "%15s %lld", op, &count) != 2)
+            continue;
+        if (strcmp(op, "read") == 0 || strcmp(op, "write") == 0) {
+            total += count;
+            found++;
+        }
+    }
+    fclose(f);
+    return found ? total : -1;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void report(const char *what, struct thread_stats *st, int threads,
+                   double seconds)
+{
+    uint64_t  ops     = 0;
+    uint64_t  errors  = 0;
+    size_t    samples = 0;
+    uint32_t *all;
+    int       i;
+
+    for (i = 0; i < threads; i++) {
+        ops += st[i].ops;
+        errors += st[i].errors;
+        samples += st[i].samples;
+    }
+
+    printf("%s: %d threads, %llu ops, %llu errors, %.0f ops/s\n", what,
+           threads, (unsigned long long)ops, (unsigned long long)errors,
+           ops / seconds);
+    if (!samples)
+        return;
+
+    all     = malloc(samples * sizeof(*all));
+    samples = 0;
+    for (i = 0; i < threads; i++) {
+        memcpy(all + samples, st[i].lat_us, st[i].samples * sizeof(*all));
+        samples += st[i].samples;
+    }
+    qsort(all, samples, sizeof(*all), cmp_u32);
+
+    printf("  latency us: p50 %u  p90 %u  p99 %u  p99.9 %u  max %u\n",
+           all[samples * 50 / 100], all[samples * 90 / 100],
+           all[samples * 99 / 100], all[samples * 999 / 1000],
+           all[samples - 1]);
+    free(all);
+}
+
+// Worker tick jitter from the samples the driver recorded during the run.
+static void report_ticks(int fd)
+{
+    struct ec_su_axb35_sample smp[256];
+    uint64_t                 *gaps  = NULL;
+    size_t                    ngaps = 0;
+    size_t                    cap   = 0;
+    uint64_t                  last  = 0;
+    double                    mean  = 0;
+    double                    var   = 0;
+    ssize_t                   n;
+    size_t                    i;
+
+    if (fd < 0) {
+        printf("worker ticks: %s not available\n", EC_SU_AXB35_HISTORY_DEV);
+        return;
+    }
+
+    while ((n = read(fd, smp, sizeof(smp))) > 0) {
+        for (i = 0; i < n / sizeof(smp[0]); i++) {
+            if (last) {
+                if (ngaps == cap) {
+                    cap  = cap ? cap * 2 : 1024;
+                    gaps = realloc(gaps, cap * sizeof(*gaps));
+                }
+                gaps[ngaps++] = smp[i].timestamp_ns - last;
+            }
+            last = smp[i].timestamp_ns;
+        }
+    }
+
+    if (ngaps < 2) {
+        printf("worker ticks: not enough samples (worker idle?)\n");
+        free(gaps);
+        return;
+    }
+
+    for (i = 0; i < ngaps; i++)
+        mean += gaps[i];
+    mean /= ngaps;
+    for (i = 0; i < ngaps; i++)
+        var += (gaps[i] - mean) * (gaps[i] - mean);
+    qsort(gaps, ngaps, sizeof(*gaps), cmp_u64);
+
+    printf("worker ticks: %zu intervals, mean %.1f ms, stddev %.2f ms, "
+           "min %.1f ms, p99 %.1f ms, max %.1f ms\n",
+           ngaps, mean / 1e6, sqrt(var / ngaps) / 1e6,
+           gaps[0] / 1e6, gaps[ngaps * 99 / 100] / 1e6,
+           gaps[ngaps - 1] / 1e6);
+    free(gaps);
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [OPTIONS]\n\n"
+           "OPTIONS:\n"
+           "  -t N       Reader threads (default: 4)\n"
+           "  -a SETS    Attribute sets to read, comma separated\n"
+           "             [rpm,mode,level,curves,temp,power_mode] (default: "
+           "all)\n"
+           "  -w N       Writer threads (default: 0)\n"
+           "  -W SETS    Attribute sets to write back (default: "
+           "level,curves)\n"
+           "  -d SECONDS Duration (default: 10)\n"
+           "  -k         Keep attribute files open and pread() them\n"
+           "  -p PATH    Class path (default: %s)\n"
+           "  -s PATH    EC statistics in debugfs (default: %s)\n"
+           "  -h         Display this usage information\n",
+           prog, class_path, stats_path);
+}
+
+int main(int argc, char **argv)
+{
+    const char          *read_sets  = "rpm,mode,level,curves,temp,power_mode";
+    const char          *write_sets = "level,curves";
+    int                  readers    = 4;
+    int                  writers    = 0;
+    int                  duration   = 10;
+    struct thread_stats *rst;
+    struct thread_stats *wst;
+    long long            tx_before;
+    long long            tx_after;
+    uint64_t             start;
+    double               seconds;
+    uint64_t             reads = 0;
+    int                  hist_fd;
+    int                  opt;
+    int                  i;
+
+    while ((opt = getopt(argc, argv, "t:a:w:W:d:kp:s:h")) != -1) {
+        switch (opt) {
+        case 't':
+            readers = atoi(optarg);
+            break;
+        case 'a':
+            read_sets = optarg;
+            break;
+        case 'w':
+            writers = atoi(optarg);
+            break;
+        case 'W':
+            write_sets = optarg;
+            break;
+        case 'd':
+            duration = atoi(optarg);
+            break;
+        case 'k':
+            keep_open = true;
+            break;
+        case 'p':
+            class_path = optarg;
+            break;
+        case 's':
+            stats_path = optarg;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (readers < 0 || writers < 0 || duration <= 0 ||
+        readers + writers == 0) {
+        fprintf(stderr, "Error: need at least one thread and a duration\n");
+        return 1;
+    }
+    if (access(class_path, R_OK) != 0) {
+        fprintf(stderr, "Error: %s is not accessible\n", class_path);
+        return 2;
+    }
+    if (parse_attr_sets(read_sets, &read_attrs) ||
+        (writers && parse_attr_sets(write_sets, &write_attrs)))
+        return 1;
+
+    rst = calloc(readers, sizeof(*rst));
+    wst = calloc(writers, sizeof(*wst));
+
+    // opened before the run, so it only returns samples from the run
+    hist_fd = open(EC_SU_AXB35_HISTORY_DEV, O_RDONLY | O_NONBLOCK);
+    if (hist_fd >= 0) {
+        struct ec_su_axb35_sample smp[256];
+
+        while (read(hist_fd, smp, sizeof(smp)) > 0)
+            ;
+    }
+
+    tx_before = ec_transactions();
+    start     = now_ns();
+
+    for (i = 0; i < readers; i++) {
+        rst[i].lat_us = malloc(MAX_SAMPLES * sizeof(uint32_t));
+        pthread_create(&rst[i].thread, NULL, reader, &rst[i]);
+    }
+    for (i = 0; i < writers; i++) {
+        wst[i].lat_us = malloc(MAX_SAMPLES * sizeof(uint32_t));
+        pthread_create(&wst[i].thread, NULL, writer, &wst[i]);
+    }
+
+    sleep(duration);
+    running = false;
+
+    for (i = 0; i < readers; i++)
+        pthread_join(rst[i].thread, NULL);
+    for (i = 0; i < writers; i++)
+        pthread_join(wst[i].thread, NULL);
+
+    seconds  = (now_ns() - start) / 1e9;
+    tx_after = ec_transactions();
+
+    printf("%s, %d attributes, %s, %.1f s\n", class_path, read_attrs.count,
+           keep_open ? "kept-open fds" : "open/read/close", seconds);
+    report("readers", rst, readers, seconds);
+    if (writers)
+        report("writers", wst, writers, seconds);
+
+    for (i = 0; i < readers; i++)
+        reads += rst[i].ops;
+    if (tx_before >= 0 && tx_after >= 0 && reads)
+        printf("EC transactions: %lld total, %.3f per logical read "
+               "(including the worker)\n",
+               tx_after - tx_before, (double)(tx_after - tx_before) / reads);
+    else
+        printf("EC transactions: %s not available (needs root and "
+               "debugfs)\n",
+               stats_path);
+
+    report_ticks(hist_fd);
+    if (hist_fd >= 0)
+        close(hist_fd);
+
+    return 0;
+}
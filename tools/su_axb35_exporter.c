@@ -0,0 +1,586 @@
+// su_axb35_exporter.c - Prometheus/OpenMetrics exporter for the ec_su_axb35
+// driver
+//
+// Serves /metrics over HTTP on a local TCP port or a unix socket. The board
+// is read through kept-open fds and the rendered metrics are cached for -t
+// milliseconds, so any number of scrapes within that window cost a single
+// sweep. The exporter is a single poll() loop; scrapes are never served in
+// parallel, which is what makes the cache sufficient.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "su_axb35_state.h"
+
+#define MAX_CLIENTS     64
+#define REQUEST_MAX     4096
+#define CLIENT_TIMEOUT  10000 // ms
+#define DEFAULT_LISTEN  "127.0.0.1:9935"
+#define PROM_TYPE       "text/plain; version=0.0.4; charset=utf-8"
+#define OPENMETRICS_TYPE \
+    "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+struct buf {
+    char   data[32768];
+    size_t len;
+};
+
+struct client {
+    int      fd;
+    uint64_t since; // ms, for the idle timeout
+    char     in[REQUEST_MAX];
+    size_t   in_len;
+    char    *out; // response, NULL while reading the request
+    size_t   out_len;
+    size_t   out_off;
+};
+
+struct exporter {
+    struct su_axb35 ec;
+    bool            ec_open;
+    const char     *path;
+    uint64_t        ttl_ms;
+
+    // cached board metrics, rendered by the last sweep
+    struct buf cache;
+    bool       cache_valid;
+    uint64_t   cache_time; // ms
+    bool       up;
+
+    // exporter metrics
+    uint64_t sweeps;
+    uint64_t sweep_errors;
+    double   sweep_seconds; // last sweep
+    uint64_t scrapes;
+    double   scrape_seconds_sum;
+};
+
+static volatile sig_atomic_t quit;
+
+// "unknown" catches modes added by newer drivers
+static const char *const fan_modes[] = { "auto", "fixed", "curve", "thermal",
+                                         "unknown" };
+static const char *const power_modes[] = { "quiet", "balanced", "performance" };
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void out(struct buf *b, const char *fmt, ...)
+{
+    va_list ap;
+    int     n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(b->data + b->len, sizeof(b->data) - b->len, fmt, ap);
+    va_end(ap);
+    if (n > 0)
+        b->len = b->len + n < sizeof(b->data) ? b->len + n : sizeof(b->data) - 1;
+}
+
+static void help(struct buf *b, const char *name, const char *type,
+                 const char *text)
+{
+    out(b, "# HELP %s %s\n# TYPE %s %s\n", name, text, name, type);
+}
+
+static void render_board(struct buf *b, const struct ec_su_axb35_state *st)
+{
+    static const char *const curves[] = { "rampup", "rampdown" };
+    unsigned int             i;
+    unsigned int             j;
+    unsigned int             k;
+
+    help(b, "su_axb35_fan_rpm", "gauge", "Fan speed in RPM.");
+    for (i = 0; i < EC_SU_AXB35_FANS; i++)
+        out(b, "su_axb35_fan_rpm{fan=\"%u\"} %u\n", i + 1, st->fan[i].rpm);
+
+    help(b, "su_axb35_fan_level", "gauge", "Fan level (0-5).");
+    for (i = 0; i < EC_SU_AXB35_FANS; i++)
+        out(b, "su_axb35_fan_level{fan=\"%u\"} %u\n", i + 1, st->fan[i].level);
+
+    help(b, "su_axb35_fan_mode", "gauge", "Fan mode, 1 for the active mode.");
+    for (i = 0; i < EC_SU_AXB35_FANS; i++) {
+        for (j = 0; j < sizeof(fan_modes) / sizeof(fan_modes[0]); j++)
+            out(b, "su_axb35_fan_mode{fan=\"%u\",mode=\"%s\"} %d\n", i + 1,
+                fan_modes[j],
+                strcmp(su_axb35_fan_mode_name(st->fan[i].mode), fan_modes[j]) ==
+                    0);
+    }
+
+    help(b, "su_axb35_fan_curve_celsius", "gauge",
+         "Curve mode temperature thresholds per level.");
+    for (i = 0; i < EC_SU_AXB35_FANS; i++) {
+        for (j = 0; j < 2; j++) {
+            const uint8_t *curve = j ? st->fan[i].rampdown_curve :
+                                       st->fan[i].rampup_curve;
+
+            for (k = 0; k < EC_SU_AXB35_CURVE_POINTS; k++)
+                out(b,
+                    "su_axb35_fan_curve_celsius{fan=\"%u\",curve=\"%s\","
+                    "level=\"%u\"} %u\n",
+                    i + 1, curves[j], k + 1, curve[k]);
+        }
+    }
+
+    help(b, "su_axb35_temp_celsius", "gauge", "APU temperature.");
+    out(b, "su_axb35_temp_celsius %u\n", st->temp);
+    help(b, "su_axb35_temp_min_celsius", "gauge",
+         "Lowest APU temperature seen by the driver.");
+    out(b, "su_axb35_temp_min_celsius %u\n", st->temp_min);
+    help(b, "su_axb35_temp_max_celsius", "gauge",
+         "Highest APU temperature seen by the driver.");
+    out(b, "su_axb35_temp_max_celsius %u\n", st->temp_max);
+
+    help(b, "su_axb35_power_mode", "gauge",
+         "APU power mode, 1 for the active mode.");
+    for (j = 0; j < sizeof(power_modes) / sizeof(power_modes[0]); j++)
+        out(b, "su_axb35_power_mode{mode=\"%s\"} %d\n", power_modes[j],
+            strcmp(su_axb35_power_mode_name(st->power_mode), power_modes[j]) ==
+                0);
+}
+
+// Re-reads the board if the cache is older than the TTL.
+static void sweep(struct exporter *e)
+{
+    struct ec_su_axb35_state st;
+    uint64_t                 start = now_ns();
+
+    if (e->cache_valid && start / 1000000 - e->cache_time < e->ttl_ms)
+        return;
+
+    // reopen after an error, e.g. the module was reloaded
+    if (!e->ec_open)
+        e->ec_open = su_axb35_open(&e->ec, e->path) == 0;
+    e->up = e->ec_open && su_axb35_read(&e->ec, &st) == 0;
+
+    e->cache.len = 0;
+    if (e->up) {
+        render_board(&e->cache, &st);
+    } else {
+        e->sweep_errors++;
+        if (e->ec_open)
+            su_axb35_close(&e->ec);
+        e->ec_open = false;
+    }
+
+    e->sweeps++;
+    e->sweep_seconds = (now_ns() - start) / 1e9;
+    e->cache_time    = start / 1000000;
+    e->cache_valid   = true;
+}
+
+// Builds the whole HTTP response for a scrape.
+static char *scrape(struct exporter *e, bool openmetrics, size_t *len)
+{
+    static struct buf b;
+    // counters are typed without the _total suffix in OpenMetrics only
+    const char *total = openmetrics ? "" : "_total";
+    uint64_t    start = now_ns();
+    char        head[256];
+    char       *resp;
+    int         n;
+
+    sweep(e);
+
+    b.len = 0;
+    out(&b, "%.*s", (int)e->cache.len, e->cache.data);
+    help(&b, "su_axb35_up", "gauge", "Whether the last sweep read the EC.");
+    out(&b, "su_axb35_up %d\n", e->up);
+
+    out(&b, "# HELP su_axb35_exporter_sweeps%s Sweeps of the board.\n", total);
+    out(&b, "# TYPE su_axb35_exporter_sweeps%s counter\n", total);
+    out(&b, "su_axb35_exporter_sweeps_total %llu\n",
+        (unsigned long long)e->sweeps);
+    out(&b, "# HELP su_axb35_exporter_sweep_errors%s Failed sweeps.\n", total);
+    out(&b, "# TYPE su_axb35_exporter_sweep_errors%s counter\n", total);
+    out(&b, "su_axb35_exporter_sweep_errors_total %llu\n",
+        (unsigned long long)e->sweep_errors);
+    help(&b, "su_axb35_exporter_sweep_duration_seconds", "gauge",
+         "Duration of the last sweep.");
+    out(&b, "su_axb35_exporter_sweep_duration_seconds %.9f\n", e->sweep_seconds);
+    help(&b, "su_axb35_exporter_cache_age_seconds", "gauge",
+         "Age of the served board metrics.");
+    out(&b, "su_axb35_exporter_cache_age_seconds %.3f\n",
+        (start / 1000000 - e->cache_time) / 1e3);
+
+    // covers the scrapes before this one
+    help(&b, "su_axb35_exporter_scrape_duration_seconds", "summary",
+         "Time spent building scrape responses.");
+    out(&b, "su_axb35_exporter_scrape_duration_seconds_sum %.9f\n",
+        e->scrape_seconds_sum);
+    out(&b, "su_axb35_exporter_scrape_duration_seconds_count %llu\n",
+        (unsigned long long)e->scrapes);
+    if (openmetrics)
+        out(&b, "# EOF\n");
+
+    n = snprintf(head, sizeof(head),
+                 "HTTP/1.1 200 OK\r\n"
+                 "Content-Type: %s\r\n"
+                 "Content-Length: %zu\r\n"
+                 "Connection: close\r\n\r\n",
+                 openmetrics ? OPENMETRICS_TYPE : PROM_TYPE, b.len);
+
+    resp = malloc(n + b.len);
+    if (resp) {
+        memcpy(resp, head, n);
+        memcpy(resp + n, b.data, b.len);
+        *len = n + b.len;
+    }
+
+    e->scrapes++;
+    e->scrape_seconds_sum += (now_ns() - start) / 1e9;
+    return resp;
+}
+
+static char *simple_response(const char *status, const char *body, size_t *len)
+{
+    char *resp;
+    int   n;
+
+    n = asprintf(&resp,
+                 "HTTP/1.1 %s\r\n"
+                 "Content-Type: text/html; charset=utf-8\r\n"
+                 "Content-Length: %zu\r\n"
+                 "Connection: close\r\n\r\n%s",
+                 status, strlen(body), body);
+    if (n < 0)
+        return NULL;
+    *len = n;
+    return resp;
+}
+
+// True if the Accept header asks for OpenMetrics.
+static bool wants_openmetrics(const char *req)
+{
+    const char *accept = strcasestr(req, "\naccept:");
+    const char *eol;
+    const char *om;
+
+    if (!accept)
+        return false;
+    eol = strchr(accept + 1, '\n');
+    om  = strstr(accept, "application/openmetrics-text");
+    return om && (!eol || om < eol);
+}
+
+// Parses the request once its header is complete and queues the response.
+// Returns false while more input is needed.
+static bool handle_request(struct exporter *e, struct client *c)
+{
+    // both stay empty when the request line does not parse
+    char method[16]  = "";
+    char target[256] = "";
+
+    c->in[c->in_len] = '\0';
+    if (!strstr(c->in, "\r\n\r\n") && !strstr(c->in, "\n\n") &&
+        c->in_len < REQUEST_MAX - 1)
+        return false;
+
+    if (sscanf(c->in, "%15s %255s", method, target) != 2) {
+        c->out = simple_response("400 Bad Request", "Bad Request\n",
+                                 &c->out_len);
+    } else if (strcmp(method, "GET") != 0 && strcmp(method, "HEAD") != 0) {
+        c->out = simple_response("405 Method Not Allowed",
+                                 "Method Not Allowed\n", &c->out_len);
+    } else if (strcmp(target, "/metrics") == 0 ||
+               strncmp(target, "/metrics?", 9) == 0) {
+        c->out = scrape(e, wants_openmetrics(c->in), &c->out_len);
+    } else if (strcmp(target, "/") == 0) {
+        c->out = simple_response(
+            "200 OK",
+            "<html><head><title>AXB35 Exporter</title></head><body>"
+            "<h1>AXB35 Exporter</h1><p><a href=\"/metrics\">Metrics</a></p>"
+            "</body></html>\n",
+            &c->out_len);
+    } else {
+        c->out = simple_response("404 Not Found", "Not Found\n", &c->out_len);
+    }
+
+    // HEAD gets the headers only
+    if (c->out && strcmp(method, "HEAD") == 0)
+        c->out_len = strstr(c->out, "\r\n\r\n") + 4 - c->out;
+    return true;
+}
+
+static void client_close(struct client *c)
+{
+    close(c->fd);
+    free(c->out);
+    c->fd  = -1;
+    c->out = NULL;
+}
+
+static int listen_tcp(const char *addr)
+{
+    struct addrinfo  hints = { .ai_family   = AF_UNSPEC,
+                               .ai_socktype = SOCK_STREAM,
+                               .ai_flags    = AI_PASSIVE };
+    struct addrinfo *res;
+    struct addrinfo *ai;
+    char             host[256];
+    const char      *port = strrchr(addr, ':');
+    int              one  = 1;
+    int              fd   = -1;
+    int              err;
+
+    // [ADDR]:PORT or PORT, brackets around IPv6 addresses
+    if (port) {
+        snprintf(host, sizeof(host), "%.*s", (int)(port - addr), addr);
+        port++;
+    } else {
+        host[0] = '\0';
+        port    = addr;
+    }
+    if (host[0] == '[' && host[strlen(host) - 1] == ']') {
+        memmove(host, host + 1, strlen(host));
+        host[strlen(host) - 1] = '\0';
+    }
+
+    err = getaddrinfo(host[0] ? host : NULL, port, &hints, &res);
+    if (err) {
+        fprintf(stderr, "su_axb35_exporter: %s: %s\n", addr, gai_strerror(err));
+        return -1;
+    }
+    for (ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                    ai->ai_protocol);
+        if (fd < 0)
+            continue;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 16) == 0)
+            break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (fd < 0)
+        fprintf(stderr, "su_axb35_exporter: can't listen on %s: %s\n", addr,
+                strerror(errno));
+    return fd;
+}
+
+static int listen_unix(const char *path)
+{
+    struct sockaddr_un sun = { .sun_family = AF_UNIX };
+    int                fd;
+
+    if (strlen(path) >= sizeof(sun.sun_path)) {
+        fprintf(stderr, "su_axb35_exporter: socket path too long\n");
+        return -1;
+    }
+    strcpy(sun.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0)
+        return -1;
+    // a stale socket from an earlier run
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&sun, sizeof(sun)) || listen(fd, 16)) {
+        fprintf(stderr, "su_axb35_exporter: can't listen on %s: %s\n", path,
+                strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    quit = 1;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [OPTIONS]\n\n"
+            "OPTIONS:\n"
+            "  -l [ADDR:]PORT  Listen on a TCP port (default: %s)\n"
+            "  -u PATH         Listen on a unix socket instead\n"
+            "  -t MS           Cache the metrics for MS milliseconds "
+            "(default: 1000)\n"
+            "  -p PATH         Read sysfs under PATH instead of the state "
+            "device or %s\n"
+            "  -h              Display this usage information\n",
+            prog, DEFAULT_LISTEN, SU_AXB35_CLASS_PATH);
+}
+
+int main(int argc, char **argv)
+{
+    static struct client clients[MAX_CLIENTS];
+    struct exporter      e      = { .ttl_ms = 1000 };
+    struct pollfd        pfds[MAX_CLIENTS + 1];
+    struct sigaction     sa;
+    const char          *listen_addr = DEFAULT_LISTEN;
+    const char          *unix_path   = NULL;
+    int                  lfd;
+    int                  opt;
+    int                  i;
+
+    while ((opt = getopt(argc, argv, "l:u:t:p:h")) != -1) {
+        switch (opt) {
+        case 'l':
+            listen_addr = optarg;
+            break;
+        case 'u':
+            unix_path = optarg;
+            break;
+        case 't':
+            e.ttl_ms = strtoull(optarg, NULL, 10);
+            break;
+        case 'p':
+            e.path = optarg;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    lfd = unix_path ? listen_unix(unix_path) : listen_tcp(listen_addr);
+    if (lfd < 0)
+        return 1;
+
+    // the first sweep also reports a missing module right away
+    e.ec_open = su_axb35_open(&e.ec, e.path) == 0;
+    if (!e.ec_open)
+        fprintf(stderr, "su_axb35_exporter: can't open the AXB35 EC: %s\n",
+                strerror(errno));
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (i = 0; i < MAX_CLIENTS; i++)
+        clients[i].fd = -1;
+
+    while (!quit) {
+        uint64_t now;
+        int      n = 0;
+
+        pfds[n].fd     = lfd;
+        pfds[n].events = POLLIN;
+        n++;
+        for (i = 0; i < MAX_CLIENTS; i++) {
+            if (clients[i].fd < 0)
+                continue;
+            pfds[n].fd     = clients[i].fd;
+            pfds[n].events = clients[i].out ? POLLOUT : POLLIN;
+            n++;
+        }
+
+        if (poll(pfds, n, 1000) < 0 && errno != EINTR)
+            break;
+        now = now_ns() / 1000000;
+
+        if (pfds[0].revents & POLLIN) {
+            int fd;
+
+            while ((fd = accept4(lfd, NULL, NULL,
+                                 SOCK_CLOEXEC | SOCK_NONBLOCK)) >= 0) {
+                for (i = 0; i < MAX_CLIENTS && clients[i].fd >= 0; i++)
+                    ;
+                if (i == MAX_CLIENTS) {
+                    close(fd);
+                    continue;
+                }
+                clients[i].fd      = fd;
+                clients[i].since   = now;
+                clients[i].in_len  = 0;
+                clients[i].out_len = 0;
+                clients[i].out_off = 0;
+            }
+        }
+
+        // the fds were polled before any new clients were accepted, so
+        // walk the clients by fd
+        for (i = 0; i < MAX_CLIENTS; i++) {
+            struct client *c       = &clients[i];
+            short          revents = 0;
+            int            j;
+            ssize_t        r;
+
+            if (c->fd < 0)
+                continue;
+            for (j = 1; j < n; j++) {
+                if (pfds[j].fd == c->fd)
+                    revents = pfds[j].revents;
+            }
+
+            if (!revents) {
+                if (now - c->since > CLIENT_TIMEOUT)
+                    client_close(c);
+                continue;
+            }
+            if (revents & (POLLERR | POLLNVAL)) {
+                client_close(c);
+                continue;
+            }
+
+            if (!c->out) {
+                r = recv(c->fd, c->in + c->in_len, REQUEST_MAX - 1 - c->in_len,
+                         0);
+                if (r <= 0) {
+                    if (r == 0 || (errno != EAGAIN && errno != EINTR))
+                        client_close(c);
+                    continue;
+                }
+                c->in_len += r;
+                if (!handle_request(&e, c))
+                    continue;
+                if (!c->out) {
+                    client_close(c);
+                    continue;
+                }
+            }
+
+            r = send(c->fd, c->out + c->out_off, c->out_len - c->out_off,
+                     MSG_NOSIGNAL);
+            if (r < 0) {
+                if (errno != EAGAIN && errno != EINTR)
+                    client_close(c);
+                continue;
+            }
+            c->out_off += r;
+            if (c->out_off == c->out_len)
+                client_close(c);
+        }
+    }
+
+    for (i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].fd >= 0)
+            client_close(&clients[i]);
+    }
+    close(lfd);
+    if (unix_path)
+        unlink(unix_path);
+    if (e.ec_open)
+        su_axb35_close(&e.ec);
+    return 0;
+}
@@ -0,0 +1,903 @@
+// su_axb35_monitor.c - terminal monitor for the ec_su_axb35 driver
+//
+// Same layout, colors and options as the old bash monitor, but the board is
+// read through kept-open fds, only cells whose text changed are redrawn,
+// and every frame goes out in a single write().
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "su_axb35_state.h"
+
+#define RESET   "\033[0m"
+#define BOLD    "\033[1m"
+#define GREEN   "\033[32m"
+#define YELLOW  "\033[33m"
+#define BLUE    "\033[34m"
+#define CYAN    "\033[36m"
+#define RED     "\033[31m"
+#define MAGENTA "\033[35m"
+
+#define BLOCK_HEIGHT 6 // 1 title + 4 data + 1 empty
+#define COLUMN_WIDTH 40
+#define VALUE_OFFSET 20
+#define VALUE_WIDTH  15
+#define SPARK_OFFSET 12
+#define SPARK_WIDTH  26
+#define HISTORY_LEN  SPARK_WIDTH
+
+enum cell_id {
+    CELL_FAN_MODE,
+    CELL_FAN_RPM = CELL_FAN_MODE + EC_SU_AXB35_FANS,
+    CELL_FAN_LEVEL = CELL_FAN_RPM + EC_SU_AXB35_FANS,
+    CELL_FAN_RAMPUP = CELL_FAN_LEVEL + EC_SU_AXB35_FANS,
+    CELL_FAN_RAMPDOWN = CELL_FAN_RAMPUP + EC_SU_AXB35_FANS,
+    CELL_TEMP = CELL_FAN_RAMPDOWN + EC_SU_AXB35_FANS,
+    CELL_TEMP_MIN,
+    CELL_TEMP_MAX,
+    CELL_POWER_MODE,
+    CELL_SPARK_TEMP,
+    CELL_SPARK_FAN,
+    CELL_COUNT = CELL_SPARK_FAN + EC_SU_AXB35_FANS,
+};
+
+struct cell {
+    int  row; // -1 = not on screen
+    int  col;
+    bool valid;
+    char text[128]; // last drawn, with color codes
+};
+
+struct frame {
+    char   buf[16384];
+    size_t len;
+};
+
+static const char *const fan_titles[EC_SU_AXB35_FANS] = {
+    "APU Fan 1",
+    "APU Fan 2",
+    "System Fan",
+};
+
+static struct cell cells[CELL_COUNT];
+static double      interval = 1.0;
+static bool        raw_mode;
+static int         term_rows;
+static int         term_cols;
+
+static volatile sig_atomic_t quit;
+static volatile sig_atomic_t resized = 1;
+
+// history for the sparklines, oldest first
+static unsigned int temp_hist[HISTORY_LEN];
+static unsigned int rpm_hist[EC_SU_AXB35_FANS][HISTORY_LEN];
+static int          hist_len;
+
+static void out(struct frame *f, const char *fmt, ...)
+{
+    va_list ap;
+    int     n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(f->buf + f->len, sizeof(f->buf) - f->len, fmt, ap);
+    va_end(ap);
+    if (n > 0)
+        f->len = f->len + n < sizeof(f->buf) ? f->len + n : sizeof(f->buf) - 1;
+}
+
+static void move(struct frame *f, int row, int col)
+{
+    out(f, "\033[%d;%dH", row + 1, col + 1);
+}
+
+static void flush(struct frame *f)
+{
+    size_t off = 0;
+
+    while (off < f->len) {
+        ssize_t n = write(STDOUT_FILENO, f->buf + off, f->len - off);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        off += n;
+    }
+    f->len = 0;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [OPTIONS]\n\n"
+           "OPTIONS:\n"
+           "  -i SECONDS   Update interval (0.05-10 seconds, default: 1)\n"
+           "  -j           Output current values in JSON and exit\n"
+           "  -r           Display raw values without additional processing\n"
+           "  -p PATH      Read sysfs under PATH instead of the state device "
+           "or %s\n"
+           "  -h, --help   Display this usage information\n\n"
+           "STREAMING:\n"
+           "  -s FORMAT    Write one ndjson or csv record per interval\n"
+           "  -o FILE      Append the records to FILE instead of stdout\n"
+           "  -b N         Flush every N records, 0 = when the buffer is full "
+           "(default: 1)\n"
+           "  -R SIZE      Rotate FILE to FILE.1, FILE.2, ... at SIZE bytes "
+           "(k, M, G)\n"
+           "  -f FIELDS    Comma separated fields to write (default: all),\n"
+           "               fanN selects all fields of that fan\n\n",
+           prog, SU_AXB35_CLASS_PATH);
+    exit(0);
+}
+
+static void format_curve(const uint8_t *curve, char *buf, size_t size)
+{
+    snprintf(buf, size, "%u,%u,%u,%u,%u", curve[0], curve[1], curve[2],
+             curve[3], curve[4]);
+}
+
+static void print_json(const struct ec_su_axb35_state *st)
+{
+    char up[32];
+    char down[32];
+    int  i;
+
+    printf("{\n");
+    for (i = 0; i < EC_SU_AXB35_FANS; i++) {
+        const struct ec_su_axb35_fan_state *fs = &st->fan[i];
+
+        format_curve(fs->rampup_curve, up, sizeof(up));
+        format_curve(fs->rampdown_curve, down, sizeof(down));
+        printf("  \"fan%d\": {\n"
+               "    \"rpm\": %u,\n"
+               "    \"mode\": \"%s\",\n"
+               "    \"level\": %u,\n"
+               "    \"rampup_curve\": \"%s\",\n"
+               "    \"rampdown_curve\": \"%s\"\n"
+               "  },\n",
+               i + 1, fs->rpm, su_axb35_fan_mode_name(fs->mode), fs->level, up,
+               down);
+    }
+    printf("  \"temperature\": {\n"
+           "    \"current\": %u,\n"
+           "    \"min\": %u,\n"
+           "    \"max\": %u\n"
+           "  },\n"
+           "  \"power_mode\": \"%s\"\n"
+           "}\n",
+           st->temp, st->temp_min, st->temp_max,
+           su_axb35_power_mode_name(st->power_mode));
+}
+
+static const char *rpm_color(unsigned int rpm)
+{
+    return rpm < 1200 ? GREEN : rpm < 3000 ? YELLOW : RED;
+}
+
+static const char *temp_color(unsigned int temp)
+{
+    return temp < 50 ? GREEN : temp < 70 ? YELLOW : RED;
+}
+
+static const char *mode_color(const char *mode)
+{
+    if (strcmp(mode, "auto") == 0)
+        return GREEN;
+    if (strcmp(mode, "fixed") == 0)
+        return YELLOW;
+    if (strcmp(mode, "curve") == 0 || strcmp(mode, "thermal") == 0)
+        return CYAN;
+    return "";
+}
+
+static const char *power_color(const char *mode)
+{
+    if (strcmp(mode, "quiet") == 0)
+        return GREEN;
+    if (strcmp(mode, "balanced") == 0)
+        return YELLOW;
+    if (strcmp(mode, "performance") == 0)
+        return RED;
+    return "";
+}
+
+// Draws the static part of the screen and places the value cells.
+static void draw_interface(struct frame *f)
+{
+    struct winsize ws;
+    char           dim_text[64];
+    int            max_columns;
+    int            usable_rows;
+    int            col = 0;
+    int            row = 2;
+    int            block;
+    int            i;
+
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row && ws.ws_col) {
+        term_rows = ws.ws_row;
+        term_cols = ws.ws_col;
+    } else {
+        term_rows = 24;
+        term_cols = 80;
+    }
+
+    for (i = 0; i < CELL_COUNT; i++) {
+        cells[i].row   = -1;
+        cells[i].valid = false;
+    }
+
+    out(f, "\033[H\033[J");
+
+    // terminal dimensions and update interval in top right corner
+    snprintf(dim_text, sizeof(dim_text), "[i:%.0fms | t:%dx%d]",
+             interval * 1000, term_cols, term_rows);
+    move(f, 0, term_cols > (int)strlen(dim_text) ?
+                   term_cols - (int)strlen(dim_text) :
+                   0);
+    out(f, CYAN "%s" RESET, dim_text);
+
+    // title
+    move(f, 0, 0);
+    out(f, BOLD MAGENTA "=== AXB35 System Monitor ===" RESET);
+
+    max_columns = term_cols / COLUMN_WIDTH;
+    if (max_columns < 1)
+        max_columns = 1;
+    usable_rows = term_rows - 4;
+
+    // 3 fan blocks, temperature & power, history
+    for (block = 0; block < EC_SU_AXB35_FANS + 2; block++) {
+        static const char *const fan_labels[] = {
+            "  Speed: ", "  Level: ", "  Ramp Up Curve: ",
+            "  Ramp Down Curve: "
+        };
+        static const char *const temp_labels[] = {
+            "  Current: ", "  Min: ", "  Max: ", "  Power Mode: "
+        };
+        static const char *const hist_labels[] = {
+            "  Temp: ", "  Fan 1: ", "  Fan 2: ", "  Fan 3: "
+        };
+        const char *const *labels;
+        const char        *title;
+        int                first;
+        int                offset;
+        int                c;
+
+        if (row + BLOCK_HEIGHT > usable_rows + 2) {
+            col++;
+            row = 2;
+        }
+        if (col >= max_columns)
+            break;
+        c = col * COLUMN_WIDTH;
+
+        if (block < EC_SU_AXB35_FANS) {
+            title  = fan_titles[block];
+            labels = fan_labels;
+            first  = CELL_FAN_RPM + block;
+            offset = VALUE_OFFSET;
+            // the mode goes on the title line
+            cells[CELL_FAN_MODE + block].row = row;
+            cells[CELL_FAN_MODE + block].col = c + VALUE_OFFSET;
+        } else if (block == EC_SU_AXB35_FANS) {
+            title  = "Temperature & Power";
+            labels = temp_labels;
+            first  = CELL_TEMP;
+            offset = VALUE_OFFSET;
+        } else {
+            title  = "History";
+            labels = hist_labels;
+            first  = CELL_SPARK_TEMP;
+            offset = SPARK_OFFSET;
+        }
+
+        move(f, row, c);
+        out(f, BOLD "%s" RESET, title);
+        for (i = 0; i < 4; i++) {
+            // fan cells are strided by fan, the others are consecutive
+            int id = block < EC_SU_AXB35_FANS ?
+                         first + i * EC_SU_AXB35_FANS :
+                         first + i;
+
+            move(f, row + 1 + i, c);
+            out(f, "%s", labels[i]);
+            cells[id].row = row + 1 + i;
+            cells[id].col = c + offset;
+        }
+        row += BLOCK_HEIGHT;
+    }
+
+    // prompt
+    move(f, term_rows - 2, 0);
+    out(f, BOLD BLUE "Press Ctrl+C to exit" RESET);
+}
+
+// Queues a cell for redrawing if its text changed. visible is the width of
+// text without color codes.
+static void set_cell(struct frame *f, int id, const char *text, int visible,
+                     int width)
+{
+    struct cell *cell = &cells[id];
+
+    if (cell->row < 0 || (cell->valid && strcmp(cell->text, text) == 0))
+        return;
+
+    snprintf(cell->text, sizeof(cell->text), "%s", text);
+    cell->valid = true;
+    move(f, cell->row, cell->col);
+    out(f, "%s%*s", text, visible < width ? width - visible : 0, "");
+}
+
+static void set_value(struct frame *f, int id, const char *color,
+                      const char *value, const char *suffix)
+{
+    char text[128];
+    int  visible = strlen(value) + strlen(suffix);
+
+    if (*color)
+        snprintf(text, sizeof(text), "%s%s" RESET "%s", color, value, suffix);
+    else
+        snprintf(text, sizeof(text), "%s%s", value, suffix);
+    set_cell(f, id, text, visible, VALUE_WIDTH);
+}
+
+static void sparkline(struct frame *f, int id, const unsigned int *hist,
+                      unsigned int lo, unsigned int hi, const char *color)
+{
+    static const char *const bars[] = { "▁", "▂", "▃", "▄",
+                                        "▅", "▆", "▇", "█" };
+    char                     text[128];
+    size_t                   len = 0;
+    int                      i;
+
+    len += snprintf(text + len, sizeof(text) - len, "%s", color);
+    for (i = 0; i < hist_len; i++) {
+        unsigned int v = hist[i] < lo ? lo : hist[i] > hi ? hi : hist[i];
+
+        len += snprintf(text + len, sizeof(text) - len, "%s",
+                        bars[(v - lo) * 7 / (hi - lo)]);
+    }
+    snprintf(text + len, sizeof(text) - len, RESET);
+    set_cell(f, id, text, hist_len, SPARK_WIDTH);
+}
+
+static void push_history(const struct ec_su_axb35_state *st)
+{
+    int i;
+
+    if (hist_len == HISTORY_LEN) {
+        memmove(temp_hist, temp_hist + 1, sizeof(temp_hist[0]) * (HISTORY_LEN - 1));
+        for (i = 0; i < EC_SU_AXB35_FANS; i++)
+            memmove(rpm_hist[i], rpm_hist[i] + 1,
+                    sizeof(rpm_hist[i][0]) * (HISTORY_LEN - 1));
+        hist_len--;
+    }
+    temp_hist[hist_len] = st->temp;
+    for (i = 0; i < EC_SU_AXB35_FANS; i++)
+        rpm_hist[i][hist_len] = st->fan[i].rpm;
+    hist_len++;
+}
+
+static void draw_values(struct frame *f, const struct ec_su_axb35_state *st)
+{
+    unsigned int tlo = 255;
+    unsigned int thi = 0;
+    unsigned int rhi = 1000;
+    char         buf[32];
+    int          i;
+    int          j;
+
+    for (i = 0; i < EC_SU_AXB35_FANS; i++) {
+        const struct ec_su_axb35_fan_state *fs   = &st->fan[i];
+        const char                         *mode = su_axb35_fan_mode_name(fs->mode);
+        // for fans in auto or fixed mode, the curves do not apply and in
+        // auto mode neither does the level
+        bool no_curve = !raw_mode && fs->mode != EC_SU_AXB35_FAN_CURVE;
+        bool no_level = !raw_mode && fs->mode == EC_SU_AXB35_FAN_AUTO;
+        char text[64];
+
+        snprintf(text, sizeof(text), "[%s%s%s]", mode_color(mode), mode,
+                 *mode_color(mode) ? RESET : "");
+        set_cell(f, CELL_FAN_MODE + i, text, strlen(mode) + 2, VALUE_WIDTH);
+
+        snprintf(buf, sizeof(buf), "%u", fs->rpm);
+        set_value(f, CELL_FAN_RPM + i, rpm_color(fs->rpm), buf, " RPM");
+
+        snprintf(buf, sizeof(buf), "%u", fs->level);
+        set_value(f, CELL_FAN_LEVEL + i, "", no_level ? "N/A" : buf, "");
+
+        format_curve(fs->rampup_curve, buf, sizeof(buf));
+        set_value(f, CELL_FAN_RAMPUP + i, "", no_curve ? "N/A" : buf, "");
+        format_curve(fs->rampdown_curve, buf, sizeof(buf));
+        set_value(f, CELL_FAN_RAMPDOWN + i, "", no_curve ? "N/A" : buf, "");
+    }
+
+    snprintf(buf, sizeof(buf), "%u", st->temp);
+    set_value(f, CELL_TEMP, temp_color(st->temp), buf, " °C");
+    snprintf(buf, sizeof(buf), "%u", st->temp_min);
+    set_value(f, CELL_TEMP_MIN, temp_color(st->temp_min), buf, " °C");
+    snprintf(buf, sizeof(buf), "%u", st->temp_max);
+    set_value(f, CELL_TEMP_MAX, temp_color(st->temp_max), buf, " °C");
+    set_value(f, CELL_POWER_MODE,
+              power_color(su_axb35_power_mode_name(st->power_mode)),
+              su_axb35_power_mode_name(st->power_mode), "");
+
+    // temperature scaled to the visible range (at least 10 °C), fan speeds
+    // from 0 to the highest visible speed
+    for (j = 0; j < hist_len; j++) {
+        tlo = temp_hist[j] < tlo ? temp_hist[j] : tlo;
+        thi = temp_hist[j] > thi ? temp_hist[j] : thi;
+        for (i = 0; i < EC_SU_AXB35_FANS; i++)
+            rhi = rpm_hist[i][j] > rhi ? rpm_hist[i][j] : rhi;
+    }
+    if (thi < tlo + 10)
+        thi = tlo + 10;
+    sparkline(f, CELL_SPARK_TEMP, temp_hist, tlo, thi, temp_color(st->temp));
+    for (i = 0; i < EC_SU_AXB35_FANS; i++)
+        sparkline(f, CELL_SPARK_FAN + i, rpm_hist[i], 0, rhi,
+                  rpm_color(st->fan[i].rpm));
+}
+
+// Streaming mode: one NDJSON or CSV record per interval.
+
+enum field_type {
+    FIELD_TIME,
+    FIELD_SEQ,
+    FIELD_TEMP,
+    FIELD_TEMP_MIN,
+    FIELD_TEMP_MAX,
+    FIELD_POWER_MODE,
+    FIELD_FAN_RPM,
+    FIELD_FAN_MODE,
+    FIELD_FAN_LEVEL,
+    FIELD_FAN_RAMPUP,
+    FIELD_FAN_RAMPDOWN,
+};
+
+struct field {
+    char            name[24];
+    enum field_type type;
+    int             fan;
+};
+
+#define MAX_FIELDS (FIELD_POWER_MODE + 1 + 5 * EC_SU_AXB35_FANS)
+
+struct stream {
+    FILE              *fp;
+    const char        *path; // NULL = stdout
+    bool               csv;
+    unsigned long      flush_every; // records per flush, 0 = when full
+    unsigned long      pending;
+    unsigned long long size;
+    unsigned long long rotate_size; // 0 = never
+    unsigned int       rotation; // last suffix used
+    struct field       fields[MAX_FIELDS];
+    int                nfields;
+};
+
+// All fields in record order.
+static int all_fields(struct field *fields)
+{
+    static const char *const board[] = {
+        "time", "seq", "temp", "temp_min", "temp_max", "power_mode",
+    };
+    static const char *const fan[] = {
+        "rpm", "mode", "level", "rampup_curve", "rampdown_curve",
+    };
+    int n = 0;
+    int i;
+    int j;
+
+    for (i = 0; i <= FIELD_POWER_MODE; i++, n++) {
+        snprintf(fields[n].name, sizeof(fields[n].name), "%s", board[i]);
+        fields[n].type = i;
+        fields[n].fan  = 0;
+    }
+    for (i = 0; i < EC_SU_AXB35_FANS; i++) {
+        for (j = 0; j < 5; j++, n++) {
+            snprintf(fields[n].name, sizeof(fields[n].name), "fan%d_%s", i + 1,
+                     fan[j]);
+            fields[n].type = FIELD_FAN_RPM + j;
+            fields[n].fan  = i;
+        }
+    }
+    return n;
+}
+
+// Selects fields from a comma separated list of field names; "fanN" selects
+// all fields of that fan. Returns -1 on an unknown name.
+static int select_fields(struct stream *s, const char *list)
+{
+    struct field all[MAX_FIELDS];
+    char        *copy = strdup(list);
+    char        *p    = copy;
+    char        *name;
+    int          count = all_fields(all);
+    int          i;
+
+    s->nfields = 0;
+    while ((name = strsep(&p, ",")) != NULL) {
+        size_t len   = strlen(name);
+        bool   found = false;
+
+        for (i = 0; i < count && s->nfields < MAX_FIELDS; i++) {
+            if (strcmp(all[i].name, name) == 0 ||
+                (strncmp(all[i].name, name, len) == 0 &&
+                 strncmp(name, "fan", 3) == 0 && all[i].name[len] == '_')) {
+                s->fields[s->nfields++] = all[i];
+                found = true;
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "Error: Unknown field '%s'\n", name);
+            free(copy);
+            return -1;
+        }
+    }
+    free(copy);
+    return 0;
+}
+
+static int parse_size(const char *arg, unsigned long long *size)
+{
+    char *end;
+
+    *size = strtoull(arg, &end, 10);
+    switch (*end) {
+    case 'G':
+        *size <<= 10;
+        // fall through
+    case 'M':
+        *size <<= 10;
+        // fall through
+    case 'k':
+    case 'K':
+        *size <<= 10;
+        end++;
+        break;
+    }
+    return end == arg || *end ? -1 : 0;
+}
+
+static void stream_header(struct stream *s)
+{
+    int i;
+
+    if (!s->csv || s->size)
+        return;
+    for (i = 0; i < s->nfields; i++)
+        s->size += fprintf(s->fp, "%s%s", i ? "," : "", s->fields[i].name);
+    s->size += fprintf(s->fp, "\n");
+}
+
+static int stream_open(struct stream *s)
+{
+    if (!s->path) {
+        s->fp = stdout;
+    } else {
+        // appends to an existing file, the header only goes into new ones
+        s->fp = fopen(s->path, "a");
+        if (!s->fp) {
+            fprintf(stderr, "Error: Can't open %s: %s\n", s->path,
+                    strerror(errno));
+            return -1;
+        }
+        fseeko(s->fp, 0, SEEK_END);
+        s->size = ftello(s->fp);
+    }
+    setvbuf(s->fp, NULL, _IOFBF, 65536);
+    stream_header(s);
+    return 0;
+}
+
+// Renames the file to the next free FILE.N and starts a new one.
+static int stream_rotate(struct stream *s)
+{
+    char rotated[PATH_MAX];
+
+    if (fclose(s->fp)) {
+        s->fp = NULL;
+        return -1;
+    }
+    do {
+        snprintf(rotated, sizeof(rotated), "%s.%u", s->path, ++s->rotation);
+    } while (access(rotated, F_OK) == 0);
+    if (rename(s->path, rotated)) {
+        s->fp = NULL;
+        return -1;
+    }
+    s->size = 0;
+    return stream_open(s);
+}
+
+static int stream_record(struct stream *s, const struct ec_su_axb35_state *st)
+{
+    struct timespec now;
+    char            rec[1024];
+    size_t          len = 0;
+    int             i;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    if (!s->csv)
+        rec[len++] = '{';
+    for (i = 0; i < s->nfields; i++) {
+        const struct field                 *fld = &s->fields[i];
+        const struct ec_su_axb35_fan_state *fs  = &st->fan[fld->fan];
+        char                                val[32];
+        bool                                str = false;
+
+        switch (fld->type) {
+        case FIELD_TIME:
+            snprintf(val, sizeof(val), "%lld.%03ld", (long long)now.tv_sec,
+                     now.tv_nsec / 1000000);
+            break;
+        case FIELD_SEQ:
+            snprintf(val, sizeof(val), "%llu", (unsigned long long)st->seq);
+            break;
+        case FIELD_TEMP:
+            snprintf(val, sizeof(val), "%u", st->temp);
+            break;
+        case FIELD_TEMP_MIN:
+            snprintf(val, sizeof(val), "%u", st->temp_min);
+            break;
+        case FIELD_TEMP_MAX:
+            snprintf(val, sizeof(val), "%u", st->temp_max);
+            break;
+        case FIELD_POWER_MODE:
+            snprintf(val, sizeof(val), "%s",
+                     su_axb35_power_mode_name(st->power_mode));
+            str = !s->csv;
+            break;
+        case FIELD_FAN_RPM:
+            snprintf(val, sizeof(val), "%u", fs->rpm);
+            break;
+        case FIELD_FAN_MODE:
+            snprintf(val, sizeof(val), "%s", su_axb35_fan_mode_name(fs->mode));
+            str = !s->csv;
+            break;
+        case FIELD_FAN_LEVEL:
+            snprintf(val, sizeof(val), "%u", fs->level);
+            break;
+        case FIELD_FAN_RAMPUP:
+            format_curve(fs->rampup_curve, val, sizeof(val));
+            str = true; // contains commas, quoted in CSV too
+            break;
+        case FIELD_FAN_RAMPDOWN:
+            format_curve(fs->rampdown_curve, val, sizeof(val));
+            str = true;
+            break;
+        }
+
+        if (s->csv)
+            len += snprintf(rec + len, sizeof(rec) - len, "%s%s%s%s",
+                            i ? "," : "", str ? "\"" : "", val,
+                            str ? "\"" : "");
+        else
+            len += snprintf(rec + len, sizeof(rec) - len, "%s\"%s\":%s%s%s",
+                            i ? "," : "", fld->name, str ? "\"" : "", val,
+                            str ? "\"" : "");
+    }
+    len += snprintf(rec + len, sizeof(rec) - len, s->csv ? "\n" : "}\n");
+
+    if (fwrite(rec, 1, len, s->fp) != len)
+        return -1;
+    s->size += len;
+
+    if (s->flush_every && ++s->pending >= s->flush_every) {
+        s->pending = 0;
+        if (fflush(s->fp))
+            return -1;
+    }
+    if (s->path && s->rotate_size && s->size >= s->rotate_size)
+        return stream_rotate(s);
+    return 0;
+}
+
+// Adds the update interval to ts.
+static void advance(struct timespec *ts)
+{
+    ts->tv_sec += (time_t)interval;
+    ts->tv_nsec += (long)((interval - (time_t)interval) * 1e9);
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_nsec -= 1000000000L;
+        ts->tv_sec++;
+    }
+}
+
+static int run_stream(struct su_axb35 *ec, struct stream *s)
+{
+    struct ec_su_axb35_state st;
+    struct timespec          next;
+    int                      ret = 0;
+
+    if (stream_open(s))
+        return 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!quit) {
+        struct timespec now;
+
+        // one pass over the board per record
+        if (su_axb35_read(ec, &st) == 0 && stream_record(s, &st)) {
+            fprintf(stderr, "Error: Can't write %s: %s\n",
+                    s->path ? s->path : "stdout", strerror(errno));
+            ret = 1;
+            break;
+        }
+
+        advance(&next);
+        // more than a second behind (stopped, or a slow disk): skip the
+        // missed records instead of bursting them out
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > next.tv_sec + 1)
+            next = now;
+        while (!quit && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+                                        NULL) == EINTR)
+            ;
+    }
+
+    if (s->fp && fclose(s->fp) && !ret) {
+        fprintf(stderr, "Error: Can't write %s: %s\n",
+                s->path ? s->path : "stdout", strerror(errno));
+        ret = 1;
+    }
+    return ret;
+}
+
+static void on_signal(int sig)
+{
+    if (sig == SIGWINCH)
+        resized = 1;
+    else
+        quit = 1;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option long_opts[] = {
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+    struct su_axb35          ec;
+    struct ec_su_axb35_state st;
+    struct sigaction         sa;
+    struct timespec          next;
+    struct frame             f = { .len = 0 };
+    struct stream            stream = { .flush_every = 1 };
+    const char              *path   = NULL;
+    const char              *fields = NULL;
+    const char              *format = NULL;
+    bool                     json   = false;
+    char                    *end;
+    int                      opt;
+
+    while ((opt = getopt_long(argc, argv, "i:jrp:s:o:b:R:f:h", long_opts, NULL)) != -1) {
+        switch (opt) {
+        case 'i':
+            interval = strtod(optarg, &end);
+            if (*end || interval < 0.05 || interval > 10) {
+                printf("Error: Interval must be between 0.05 and 10 seconds\n");
+                return 1;
+            }
+            break;
+        case 'j':
+            json = true;
+            break;
+        case 'r':
+            raw_mode = true;
+            break;
+        case 'p':
+            path = optarg;
+            break;
+        case 's':
+            format = optarg;
+            break;
+        case 'o':
+            stream.path = strcmp(optarg, "-") ? optarg : NULL;
+            break;
+        case 'b':
+            stream.flush_every = strtoul(optarg, &end, 10);
+            if (*end || end == optarg) {
+                printf("Error: Invalid flush count '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'R':
+            if (parse_size(optarg, &stream.rotate_size)) {
+                printf("Error: Invalid rotation size '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'f':
+            fields = optarg;
+            break;
+        case 'h':
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (format) {
+        if (strcmp(format, "csv") == 0) {
+            stream.csv = true;
+        } else if (strcmp(format, "ndjson") != 0) {
+            printf("Error: Format must be ndjson or csv\n");
+            return 1;
+        }
+        if (!fields)
+            stream.nfields = all_fields(stream.fields);
+        else if (select_fields(&stream, fields))
+            return 1;
+    }
+
+    // check if module is loaded and path exists
+    if (su_axb35_open(&ec, path) || su_axb35_read(&ec, &st)) {
+        printf("Error: Module 'ec_su_axb35' is not loaded or not accessible\n");
+        return 2;
+    }
+
+    if (json) {
+        print_json(&st);
+        return 0;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal; // no SA_RESTART, a resize ends the sleep
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (format)
+        return run_stream(&ec, &stream);
+
+    sigaction(SIGWINCH, &sa, NULL);
+
+    // hide cursor
+    out(&f, "\033[?25l");
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!quit) {
+        struct timespec now;
+
+        if (resized) {
+            resized = 0;
+            draw_interface(&f);
+            if (hist_len)
+                draw_values(&f, &st);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > next.tv_sec ||
+            (now.tv_sec == next.tv_sec && now.tv_nsec >= next.tv_nsec)) {
+            if (su_axb35_read(&ec, &st) == 0) {
+                push_history(&st);
+                draw_values(&f, &st);
+            }
+            advance(&next);
+        }
+        flush(&f);
+
+        // a signal ends the sleep early, so a resize is redrawn right away
+        // while the samples stay on schedule
+        if (!quit && !resized)
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+
+    // cleanup: show cursor, reset attributes, clear
+    out(&f, "\033[?25h" RESET "\033[H\033[2J");
+    flush(&f);
+    printf("Monitor terminated.\n");
+    su_axb35_close(&ec);
+    return 0;
+}
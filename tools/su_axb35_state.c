@@ -0,0 +1,265 @@
+// su_axb35_state.c - board state reader shared by the userspace tools
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "su_axb35_state.h"
+
+static const char *const fan_attr_names[SU_AXB35_FAN_ATTRS] = {
+    "rpm", "mode", "level", "rampup_curve", "rampdown_curve",
+};
+
+static const char *const temp_attr_names[SU_AXB35_TEMP_ATTRS] = {
+    "temp", "min", "max",
+};
+
+static const char *const fan_mode_names[] = {
+    [EC_SU_AXB35_FAN_AUTO]    = "auto",
+    [EC_SU_AXB35_FAN_FIXED]   = "fixed",
+    [EC_SU_AXB35_FAN_CURVE]   = "curve",
+    [EC_SU_AXB35_FAN_THERMAL] = "thermal",
+};
+
+static const char *const power_mode_names[] = {
+    [EC_SU_AXB35_POWER_BALANCED]    = "balanced",
+    [EC_SU_AXB35_POWER_PERFORMANCE] = "performance",
+    [EC_SU_AXB35_POWER_QUIET]       = "quiet",
+};
+
+static int open_attr(const char *path, const char *dir, const char *name)
+{
+    char file[PATH_MAX];
+
+    snprintf(file, sizeof(file), "%s/%s/%s", path, dir, name);
+    return open(file, O_RDONLY | O_CLOEXEC);
+}
+
+int su_axb35_open(struct su_axb35 *ec, const char *path)
+{
+    char dir[8];
+    int  i;
+    int  j;
+
+    memset(ec, 0, sizeof(*ec));
+    ec->dev_fd = -1;
+
+    if (!path) {
+        ec->dev_fd = open(EC_SU_AXB35_DEV, O_RDONLY | O_CLOEXEC);
+        if (ec->dev_fd >= 0)
+            return 0;
+        path = SU_AXB35_CLASS_PATH;
+    }
+
+    for (i = 0; i < EC_SU_AXB35_FANS; i++) {
+        snprintf(dir, sizeof(dir), "fan%d", i + 1);
+        for (j = 0; j < SU_AXB35_FAN_ATTRS; j++)
+            ec->fan_fd[i][j] = open_attr(path, dir, fan_attr_names[j]);
+    }
+    for (j = 0; j < SU_AXB35_TEMP_ATTRS; j++)
+        ec->temp_fd[j] = open_attr(path, "temp1", temp_attr_names[j]);
+    ec->power_fd = open_attr(path, "apu", "power_mode");
+
+    // the temperature is the one attribute every tool needs
+    if (ec->temp_fd[SU_AXB35_TEMP] < 0) {
+        int err = errno;
+
+        su_axb35_close(ec);
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+void su_axb35_close(struct su_axb35 *ec)
+{
+    int i;
+    int j;
+
+    if (ec->dev_fd >= 0) {
+        close(ec->dev_fd);
+        ec->dev_fd = -1;
+        return;
+    }
+
+    for (i = 0; i < EC_SU_AXB35_FANS; i++) {
+        for (j = 0; j < SU_AXB35_FAN_ATTRS; j++) {
+            if (ec->fan_fd[i][j] >= 0)
+                close(ec->fan_fd[i][j]);
+            ec->fan_fd[i][j] = -1;
+        }
+    }
+    for (j = 0; j < SU_AXB35_TEMP_ATTRS; j++) {
+        if (ec->temp_fd[j] >= 0)
+            close(ec->temp_fd[j]);
+        ec->temp_fd[j] = -1;
+    }
+    if (ec->power_fd >= 0)
+        close(ec->power_fd);
+    ec->power_fd = -1;
+}
+
+// Reads one attribute without its trailing newline.
+static int read_attr(int fd, char *buf, size_t size)
+{
+    ssize_t n;
+
+    if (fd < 0) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    n = pread(fd, buf, size - 1, 0);
+    if (n < 0)
+        return -1;
+    while (n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == ' '))
+        n--;
+    buf[n] = '\0';
+    return 0;
+}
+
+static int read_uint(int fd, unsigned long *val)
+{
+    char  buf[32];
+    char *end;
+
+    if (read_attr(fd, buf, sizeof(buf)))
+        return -1;
+
+    errno = 0;
+    *val  = strtoul(buf, &end, 10);
+    if (errno || end == buf) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+static int read_name(int fd, const char *const *names, size_t count,
+                     uint8_t *val)
+{
+    char   buf[32];
+    size_t i;
+
+    if (read_attr(fd, buf, sizeof(buf)))
+        return -1;
+
+    for (i = 0; i < count; i++) {
+        if (names[i] && strcmp(buf, names[i]) == 0) {
+            *val = i;
+            return 0;
+        }
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+static int read_curve(int fd, uint8_t *curve)
+{
+    char  buf[64];
+    char *p = buf;
+    int   i;
+
+    if (read_attr(fd, buf, sizeof(buf)))
+        return -1;
+
+    for (i = 0; i < EC_SU_AXB35_CURVE_POINTS; i++) {
+        char *end;
+
+        curve[i] = strtoul(p, &end, 10);
+        if (end == p) {
+            errno = EINVAL;
+            return -1;
+        }
+        p = *end == ',' ? end + 1 : end;
+    }
+    return 0;
+}
+
+static int read_sysfs(struct su_axb35 *ec, struct ec_su_axb35_state *st)
+{
+    struct timespec ts;
+    unsigned long   val;
+    int             i;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    st->version      = EC_SU_AXB35_STATE_VERSION;
+    st->size         = sizeof(*st);
+    st->seq          = ++ec->seq;
+    st->timestamp_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+    for (i = 0; i < EC_SU_AXB35_FANS; i++) {
+        struct ec_su_axb35_fan_state *fs = &st->fan[i];
+        const int                    *fd = ec->fan_fd[i];
+
+        if (read_uint(fd[SU_AXB35_FAN_RPM], &val))
+            return -1;
+        fs->rpm = val;
+        if (read_name(fd[SU_AXB35_FAN_MODE], fan_mode_names,
+                      sizeof(fan_mode_names) / sizeof(fan_mode_names[0]),
+                      &fs->mode))
+            return -1;
+        if (read_uint(fd[SU_AXB35_FAN_LEVEL], &val))
+            return -1;
+        fs->level = val;
+        if (read_curve(fd[SU_AXB35_FAN_RAMPUP], fs->rampup_curve) ||
+            read_curve(fd[SU_AXB35_FAN_RAMPDOWN], fs->rampdown_curve))
+            return -1;
+    }
+
+    if (read_uint(ec->temp_fd[SU_AXB35_TEMP], &val))
+        return -1;
+    st->temp = val;
+    if (read_uint(ec->temp_fd[SU_AXB35_TEMP_MIN], &val))
+        return -1;
+    st->temp_min = val;
+    if (read_uint(ec->temp_fd[SU_AXB35_TEMP_MAX], &val))
+        return -1;
+    st->temp_max = val;
+
+    return read_name(ec->power_fd, power_mode_names,
+                     sizeof(power_mode_names) / sizeof(power_mode_names[0]),
+                     &st->power_mode);
+}
+
+int su_axb35_read(struct su_axb35 *ec, struct ec_su_axb35_state *st)
+{
+    ssize_t n;
+
+    memset(st, 0, sizeof(*st));
+    if (ec->dev_fd < 0)
+        return read_sysfs(ec, st);
+
+    n = pread(ec->dev_fd, st, sizeof(*st), 0);
+    if (n < 0)
+        return -1;
+    // every driver with this version returns at least the whole struct;
+    // fields appended by newer drivers are cut off by the read size
+    if (n < (ssize_t)sizeof(*st) ||
+        st->version != EC_SU_AXB35_STATE_VERSION) {
+        errno = EPROTO;
+        return -1;
+    }
+    return 0;
+}
+
+const char *su_axb35_fan_mode_name(unsigned int mode)
+{
+    if (mode < sizeof(fan_mode_names) / sizeof(fan_mode_names[0]) &&
+        fan_mode_names[mode])
+        return fan_mode_names[mode];
+    return "unknown";
+}
+
+const char *su_axb35_power_mode_name(unsigned int mode)
+{
+    if (mode < sizeof(power_mode_names) / sizeof(power_mode_names[0]) &&
+        power_mode_names[mode])
+        return power_mode_names[mode];
+    return "unknown";
+}
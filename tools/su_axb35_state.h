@@ -0,0 +1,50 @@
+// su_axb35_state.h - board state reader shared by the userspace tools
+//
+// Reads the whole board into a struct ec_su_axb35_state, from the state
+// device when it is available, otherwise from the sysfs attributes. Every
+// file is opened once and re-read with pread().
+
+#ifndef SU_AXB35_STATE_H
+#define SU_AXB35_STATE_H
+
+#include <stdint.h>
+
+#include "ec_su_axb35.h"
+
+#define SU_AXB35_CLASS_PATH "/sys/class/ec_su_axb35"
+
+enum su_axb35_fan_attr {
+    SU_AXB35_FAN_RPM,
+    SU_AXB35_FAN_MODE,
+    SU_AXB35_FAN_LEVEL,
+    SU_AXB35_FAN_RAMPUP,
+    SU_AXB35_FAN_RAMPDOWN,
+    SU_AXB35_FAN_ATTRS,
+};
+
+enum su_axb35_temp_attr {
+    SU_AXB35_TEMP,
+    SU_AXB35_TEMP_MIN,
+    SU_AXB35_TEMP_MAX,
+    SU_AXB35_TEMP_ATTRS,
+};
+
+struct su_axb35 {
+    int      dev_fd; // state device, -1 when reading sysfs
+    int      fan_fd[EC_SU_AXB35_FANS][SU_AXB35_FAN_ATTRS];
+    int      temp_fd[SU_AXB35_TEMP_ATTRS];
+    int      power_fd;
+    uint64_t seq; // local sequence for sysfs reads
+};
+
+// path is the class directory to read from sysfs, or NULL to use the state
+// device if it can be opened and SU_AXB35_CLASS_PATH otherwise. Returns 0 or
+// -1 with errno set.
+int  su_axb35_open(struct su_axb35 *ec, const char *path);
+int  su_axb35_read(struct su_axb35 *ec, struct ec_su_axb35_state *st);
+void su_axb35_close(struct su_axb35 *ec);
+
+const char *su_axb35_fan_mode_name(unsigned int mode);
+const char *su_axb35_power_mode_name(unsigned int mode);
+
+#endif // SU_AXB35_STATE_H